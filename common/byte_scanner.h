@@ -0,0 +1,223 @@
+/*******************************************************************************
+ * Author: Dyinnz.HUST.UniqueStudio
+ * Email:  ml_143@sina.com
+ * Github: https://github.com/dyinnz
+ * Date:   2016-11-04
+ ******************************************************************************/
+
+/**
+ * This is a simple library scanning bytes in blocks by SIMD instructions.
+ *
+ * The scanner finds the first byte in (or not in) a small set of bytes, and
+ * counts the LFs skipped by popcount. AVX2 is used if compiled with -mavx2,
+ * otherwise SSE2, and a scalar loop is the fallback on other platforms.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace byte_scanner {
+
+/**
+ * @brief   A small set of bytes, each one is compared in a SIMD register
+ */
+class ByteSet {
+ public:
+  static constexpr size_t kMaxSize = 8;
+
+  /**
+   * @return    false if the set is full
+   */
+  bool Insert(char c) {
+    if (Contains(c)) {
+      return true;
+    }
+    if (size_ >= kMaxSize) {
+      return false;
+    }
+    bytes_[size_++] = c;
+    return true;
+  }
+
+  bool Contains(char c) const {
+    for (size_t i = 0; i < size_; ++i) {
+      if (bytes_[i] == c) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool empty() const {
+    return 0 == size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  char operator[](size_t i) const {
+    return bytes_[i];
+  }
+
+ private:
+  char bytes_[kMaxSize]{};
+  size_t size_{0};
+};
+
+/**
+ * @brief   The LFs skipped by scanning
+ */
+struct LineCounter {
+  size_t lf_count{0};
+  const char *last_lf{nullptr};
+};
+
+namespace detail {
+
+/**
+ * @param mask    the bit i is set if block[i] is a LF
+ */
+inline void CountLF(const char *block, uint32_t mask, LineCounter &counter) {
+  if (mask) {
+    counter.lf_count += __builtin_popcount(mask);
+    counter.last_lf = block + (31 - __builtin_clz(mask));
+  }
+}
+
+/**
+ * @brief   Scan until the first byte whose membership is kStopAtMember, and
+ *          count the LFs if kCountLF
+ */
+template<bool kStopAtMember, bool kCountLF>
+inline const char *Scan(const char *p,
+                        const char *end,
+                        const ByteSet &set,
+                        LineCounter &counter) {
+#if defined(__AVX2__)
+  constexpr size_t kBlockSize = 32;
+  __m256i needles[ByteSet::kMaxSize];
+  for (size_t i = 0; i < set.size(); ++i) {
+    needles[i] = _mm256_set1_epi8(set[i]);
+  }
+  const __m256i lf = _mm256_set1_epi8('\n');
+
+  while (static_cast<size_t>(end - p) >= kBlockSize) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hit = _mm256_setzero_si256();
+    for (size_t i = 0; i < set.size(); ++i) {
+      hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(block, needles[i]));
+    }
+    uint32_t member = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+    uint32_t stop = kStopAtMember ? member : ~member;
+    uint32_t lf_mask = 0;
+    if (kCountLF) {
+      lf_mask = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf)));
+    }
+
+    if (stop) {
+      uint32_t index = __builtin_ctz(stop);
+      CountLF(p, lf_mask & ((1u << index) - 1), counter);
+      return p + index;
+    }
+    CountLF(p, lf_mask, counter);
+    p += kBlockSize;
+  }
+
+#elif defined(__SSE2__)
+  constexpr size_t kBlockSize = 16;
+  __m128i needles[ByteSet::kMaxSize];
+  for (size_t i = 0; i < set.size(); ++i) {
+    needles[i] = _mm_set1_epi8(set[i]);
+  }
+  const __m128i lf = _mm_set1_epi8('\n');
+
+  while (static_cast<size_t>(end - p) >= kBlockSize) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hit = _mm_setzero_si128();
+    for (size_t i = 0; i < set.size(); ++i) {
+      hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, needles[i]));
+    }
+    uint32_t member = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+    uint32_t stop = kStopAtMember ? member : (~member & 0xFFFF);
+    uint32_t lf_mask = 0;
+    if (kCountLF) {
+      lf_mask = static_cast<uint32_t>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(block, lf)));
+    }
+
+    if (stop) {
+      uint32_t index = __builtin_ctz(stop);
+      CountLF(p, lf_mask & ((1u << index) - 1), counter);
+      return p + index;
+    }
+    CountLF(p, lf_mask, counter);
+    p += kBlockSize;
+  }
+#endif
+
+  // the tail, or the scalar fallback
+  while (p < end && set.Contains(*p) != kStopAtMember) {
+    if (kCountLF && '\n' == *p) {
+      counter.lf_count += 1;
+      counter.last_lf = p;
+    }
+    p += 1;
+  }
+  return p;
+}
+
+} // end of namespace detail
+
+/**
+ * @param p       the begin position
+ * @param end     the end position
+ * @param set     the bytes to be skipped
+ * @param counter the LFs skipped are added to it
+ * @return        the first byte not in the set, or end
+ */
+inline const char *SkipBytes(const char *p,
+                             const char *end,
+                             const ByteSet &set,
+                             LineCounter &counter) {
+  return detail::Scan<false, true>(p, end, set, counter);
+}
+
+inline const char *SkipBytes(const char *p,
+                             const char *end,
+                             const ByteSet &set) {
+  LineCounter counter;
+  return detail::Scan<false, false>(p, end, set, counter);
+}
+
+/**
+ * @param p       the begin position
+ * @param end     the end position
+ * @param set     the bytes to be found
+ * @param counter the LFs skipped are added to it
+ * @return        the first byte in the set, or end
+ */
+inline const char *FindBytes(const char *p,
+                             const char *end,
+                             const ByteSet &set,
+                             LineCounter &counter) {
+  return detail::Scan<true, true>(p, end, set, counter);
+}
+
+inline const char *FindBytes(const char *p,
+                             const char *end,
+                             const ByteSet &set) {
+  LineCounter counter;
+  return detail::Scan<true, false>(p, end, set, counter);
+}
+
+} // end of namespace byte_scanner
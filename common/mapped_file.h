@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Author: Dyinnz.HUST.UniqueStudio
+ * Email:  ml_143@sina.com
+ * Github: https://github.com/dyinnz
+ * Date:   2016-11-08
+ ******************************************************************************/
+
+/**
+ * This is a simple library reading the whole file into memory.
+ *
+ * A regular file is mapped by mmap(), so that there is no copy and no
+ * zero-fill before using the data. The pages are populated and read ahead
+ * sequentially. Other files, such as pipes, fall back to buffered reads.
+ *
+ * NOTICE: the data is NOT terminated by '\0'.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief   A read-only file in memory, using RAII
+ */
+class MappedFile {
+ public:
+  MappedFile() = default;
+
+  explicit MappedFile(const std::string &path) {
+    Open(path);
+  }
+
+  ~MappedFile() {
+    Close();
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * @param path    the path of file
+   * @return        whether succeed
+   */
+  bool Open(const std::string &path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    if (0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+      int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+      flags |= MAP_POPULATE;
+#endif
+      auto size = static_cast<size_t>(st.st_size);
+      void *addr = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+      if (MAP_FAILED != addr) {
+        madvise(addr, size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(addr);
+        size_ = size;
+        is_mapped_ = true;
+        close(fd);
+        return true;
+      }
+    }
+
+    // pipes, empty files, or failed to map
+    bool is_ok = ReadAll(fd);
+    close(fd);
+    return is_ok;
+  }
+
+  /**
+   * @brief     Unmap or release the data
+   */
+  void Close() {
+    if (is_mapped_) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+    std::vector<char>().swap(buffer_);
+    data_ = nullptr;
+    size_ = 0;
+    is_mapped_ = false;
+  }
+
+  /**
+   * @return    the data of file, or nullptr if failed to open
+   */
+  const char *data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool IsMapped() const {
+    return is_mapped_;
+  }
+
+ private:
+  bool ReadAll(int fd) {
+    constexpr size_t kReadSize = 64 * 1024;
+    size_t size = 0;
+    while (true) {
+      buffer_.resize(size + kReadSize);
+      ssize_t n = read(fd, buffer_.data() + size, kReadSize);
+      if (n < 0 && EINTR == errno) {
+        // interrupted by a signal before reading anything, try again
+        continue;
+      }
+      if (n < 0) {
+        std::vector<char>().swap(buffer_);
+        return false;
+      }
+      if (0 == n) {
+        break;
+      }
+      size += static_cast<size_t>(n);
+    }
+
+    buffer_.resize(size);
+    // the data of an empty file is not nullptr
+    buffer_.reserve(1);
+    data_ = buffer_.data();
+    size_ = size;
+    return true;
+  }
+
+ private:
+  const char *data_{nullptr};
+  size_t size_{0};
+  bool is_mapped_{false};
+  std::vector<char> buffer_;
+};
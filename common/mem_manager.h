@@ -12,12 +12,19 @@
  *
  * You could use any level of three, but the class SmallObjPool is easiest to
  * use.
+ *
+ * The class MonotonicArena is another choice for the objects which are freed
+ * all at once, such as the nodes of a tree.
  */
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <iostream>
 
@@ -176,3 +183,128 @@ class SmallObjPool {
   FixedAllocator fixed_alloc_;
   std::vector<T *> records_;
 };
+
+/**
+ * @brief A class allocating memory by bumping a pointer in fixed-size slabs.
+ *        The memory is not freed one by one, but all at once when the arena
+ *        is released, so the objects created should be trivially
+ *        destructible.
+ */
+class MonotonicArena {
+ public:
+  static constexpr std::size_t kDefaultSlabSize = 64 * 1024;
+
+  explicit MonotonicArena(std::size_t slab_size = kDefaultSlabSize)
+      : slab_size_(slab_size) {}
+
+  MonotonicArena(const MonotonicArena &) = delete;
+  MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+  MonotonicArena(MonotonicArena &&other) noexcept {
+    *this = std::move(other);
+  }
+
+  MonotonicArena &operator=(MonotonicArena &&other) noexcept {
+    if (this != &other) {
+      Release();
+      slabs_.swap(other.slabs_);
+      curr_ = other.curr_;
+      end_ = other.end_;
+      slab_size_ = other.slab_size_;
+      other.curr_ = nullptr;
+      other.end_ = nullptr;
+    }
+    return *this;
+  }
+
+  ~MonotonicArena() {
+    Release();
+  }
+
+  /**
+   * @param size    the size of memory
+   * @param align   the alignment, should be a power of 2
+   * @return        the memory, which is valid until the arena is released
+   */
+  void *Allocate(std::size_t size,
+                 std::size_t align = alignof(std::max_align_t)) {
+    assert(0 != align && 0 == (align & (align - 1)));
+
+    // the large one takes a slab by itself, the current slab is kept
+    if (size + align > slab_size_) {
+      uint8_t *slab = new uint8_t[size + align];
+      slabs_.push_back(slab);
+      return AlignUp(slab, align);
+    }
+
+    uint8_t *p = curr_ ? AlignUp(curr_, align) : nullptr;
+    if (!p || p + size > end_) {
+      uint8_t *slab = new uint8_t[slab_size_];
+      slabs_.push_back(slab);
+      end_ = slab + slab_size_;
+      p = AlignUp(slab, align);
+    }
+    curr_ = p + size;
+    return p;
+  }
+
+  template<class T, class... A>
+  T *Create(A &&... args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "the destructor is not called by the arena");
+    return new(Allocate(sizeof(T), alignof(T))) T(std::forward<A>(args)...);
+  }
+
+  /**
+   * @brief     Allocate the memory of an array, the elements are not
+   *            initialized
+   */
+  template<class T>
+  T *AllocateArray(std::size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "the destructor is not called by the arena");
+    return static_cast<T *>(Allocate(sizeof(T) * n, alignof(T)));
+  }
+
+  /**
+   * @brief     Take over the slabs of another arena, so that the memory
+   *            allocated by it lives as long as this arena. The current slab
+   *            of this arena is kept for the following allocations.
+   */
+  void Adopt(MonotonicArena &&other) {
+    if (this != &other) {
+      slabs_.insert(slabs_.end(), other.slabs_.begin(), other.slabs_.end());
+      other.slabs_.clear();
+      other.curr_ = nullptr;
+      other.end_ = nullptr;
+    }
+  }
+
+  /**
+   * @brief     Free all the memory at once
+   */
+  void Release() {
+    for (auto slab : slabs_) {
+      delete[] slab;
+    }
+    slabs_.clear();
+    curr_ = nullptr;
+    end_ = nullptr;
+  }
+
+  std::size_t slab_num() const {
+    return slabs_.size();
+  }
+
+ private:
+  static uint8_t *AlignUp(uint8_t *p, std::size_t align) {
+    auto address = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((align - address % align) % align);
+  }
+
+ private:
+  std::vector<uint8_t *> slabs_;
+  uint8_t *curr_{nullptr};
+  uint8_t *end_{nullptr};
+  std::size_t slab_size_{kDefaultSlabSize};
+};
@@ -2,11 +2,209 @@
 // Created by Dyinnz on 16-10-24.
 //
 
+#include <cstring>
+#include <unordered_map>
 #include "ast.h"
 #include "simplelogger.h"
 
 using namespace simple_logger;
 
+namespace {
+
+size_t HashCombine(size_t hash, size_t value) {
+  return hash ^ (value + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+} // end of namespace
+
+constexpr uint32_t Ast::kNoOffset;
+
+/**
+ * @see ast.h
+ */
+void Ast::ReplaceChildren(AstNode *parent,
+                          size_t first,
+                          size_t removed_num,
+                          const std::vector<AstNode *> &children) {
+  AstNode **old_children = parent->children_;
+  AstNode **tail = old_children + first + removed_num;
+  AstNode **tail_end = old_children + parent->children_size_;
+  size_t size = parent->children_size_ - removed_num + children.size();
+
+  if (size > parent->children_capacity_) {
+    uint32_t capacity = std::max<uint32_t>(static_cast<uint32_t>(size),
+                                           parent->children_capacity_ * 2);
+    parent->children_ = arena_.AllocateArray<AstNode *>(capacity);
+    parent->children_capacity_ = capacity;
+    std::copy(old_children, old_children + first, parent->children_);
+    std::copy(tail, tail_end, parent->children_ + first + children.size());
+
+  } else if (children.size() > removed_num) {
+    // the tail moves backward, in place
+    std::copy_backward(tail, tail_end,
+                       tail_end + (children.size() - removed_num));
+
+  } else {
+    std::copy(tail, tail_end, old_children + first + children.size());
+  }
+
+  std::copy(children.begin(), children.end(), parent->children_ + first);
+  parent->children_size_ = static_cast<uint32_t>(size);
+  if (children.end() != std::find(children.begin(), children.end(), nullptr)) {
+    is_complete_ = false;
+  }
+}
+
+/**
+ * @see ast.h
+ */
+void Ast::EditSource(const char *beg,
+                     const char *end,
+                     uint32_t edit_offset,
+                     uint32_t removed_len,
+                     uint32_t inserted_len) {
+  const uint32_t edit_end = edit_offset + removed_len;
+  const int64_t delta = static_cast<int64_t>(inserted_len) - removed_len;
+
+  std::vector<AstNode *> stack;
+  if (root_) {
+    stack.push_back(root_);
+  }
+  while (!stack.empty()) {
+    AstNode *node = stack.back();
+    stack.pop_back();
+    if (node->text_) {
+      uint32_t offset = static_cast<uint32_t>(node->text_ - source_);
+      if (offset >= edit_end) {
+        offset = static_cast<uint32_t>(offset + delta);
+      } else if (offset > edit_offset) {
+        offset = edit_offset;
+      }
+      node->text_ = beg + offset;
+    }
+    for (auto child : node->children()) {
+      if (child) {
+        stack.push_back(child);
+      }
+    }
+  }
+
+  set_source(beg, end);
+}
+
+/**
+ * @see ast.h
+ */
+size_t Ast::HashConsExprs(const std::function<bool(const Symbol &)> &is_pure) {
+  constexpr uint32_t kNoClass = UINT32_MAX;
+
+  // a class of identical sub trees, represented by the first one
+  struct ConsClass {
+    const AstNode *node;
+    size_t first_child;   // the classes of its children in child_classes
+  };
+  // the result of a visited sub tree
+  struct ConsValue {
+    uint32_t cls;         // kNoClass if the sub tree is not pure
+    uint32_t beg;         // the range of text covered by its tokens
+    uint32_t end;
+  };
+
+  std::vector<ConsClass> classes;
+  std::vector<uint32_t> child_classes;
+  std::unordered_multimap<size_t, uint32_t> table;
+  std::vector<ConsValue> values;
+  std::vector<std::pair<AstNode *, size_t>> stack;
+  if (root_) {
+    stack.emplace_back(root_, 0);
+  }
+
+  // visit in post-order, so that the children are classified first
+  size_t shared_num = 0;
+  while (!stack.empty()) {
+    AstNode *node = stack.back().first;
+    auto children = node->children();
+    size_t i = stack.back().second++;
+    if (i < children.size()) {
+      if (children[i]) {
+        stack.emplace_back(children[i], 0);
+      } else {
+        values.push_back({kNoClass, kNoOffset, 0});
+      }
+      continue;
+    }
+    stack.pop_back();
+
+    const ConsValue *child_values = values.data() + values.size()
+        - children.size();
+    ConsValue value{kNoClass, kNoOffset, 0};
+    bool is_pure_tree = is_pure(node->symbol_);
+    size_t hash = static_cast<size_t>(node->symbol_.ID());
+    if (node->text_) {
+      value.beg = offset(node);
+      value.end = value.beg + node->length_;
+      for (uint32_t k = 0; k < node->length_; ++k) {
+        hash = HashCombine(hash, static_cast<unsigned char>(node->text_[k]));
+      }
+    }
+    for (size_t k = 0; k < children.size(); ++k) {
+      value.beg = std::min(value.beg, child_values[k].beg);
+      value.end = std::max(value.end, child_values[k].end);
+      is_pure_tree = is_pure_tree && kNoClass != child_values[k].cls;
+      hash = HashCombine(hash, child_values[k].cls);
+    }
+
+    if (is_pure_tree) {
+      // find the identical one by comparing the classes of children
+      auto range = table.equal_range(hash);
+      for (auto iter = range.first; iter != range.second; ++iter) {
+        const ConsClass &cls = classes[iter->second];
+        const AstNode *first = cls.node;
+        if (first->symbol_ != node->symbol_
+            || first->length_ != node->length_
+            || !first->text_ != !node->text_
+            || first->children_size_ != children.size()
+            || (node->text_
+                && 0 != memcmp(first->text_, node->text_, node->length_))) {
+          continue;
+        }
+        size_t k = 0;
+        while (k < children.size()
+            && child_classes[cls.first_child + k] == child_values[k].cls) {
+          k += 1;
+        }
+        if (k == children.size()) {
+          value.cls = iter->second;
+          break;
+        }
+      }
+
+      if (kNoClass == value.cls) {
+        value.cls = static_cast<uint32_t>(classes.size());
+        classes.push_back({node, child_classes.size()});
+        for (size_t k = 0; k < children.size(); ++k) {
+          child_classes.push_back(child_values[k].cls);
+        }
+        table.emplace(hash, value.cls);
+
+      } else if (!children.empty() && value.beg < value.end
+          && !memchr(source_ + value.beg, '\n', value.end - value.beg)) {
+        // all the tokens are in one line, so that the rows of the shared
+        // children are the row of the node itself
+        node->children_ = classes[value.cls].node->children_;
+        node->children_capacity_ = 0;
+        shared_num += 1;
+      }
+    }
+
+    values.resize(values.size() - children.size());
+    values.push_back(value);
+  }
+
+  is_hash_consed_ = is_hash_consed_ || 0 != shared_num;
+  return shared_num;
+}
+
 /**
  * @see ast.h
  */
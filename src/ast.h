@@ -4,17 +4,74 @@
 
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 #include <vector>
 #include "token.h"
+#include "line_index.h"
 #include "mem_manager.h"
 
+class AstNode;
+
+/**
+ * @brief   A read-only view of the children of node, which are stored in the
+ *          arena of ast, and could be used like a std::vector
+ */
+class AstChildren {
+ public:
+  typedef AstNode *const *const_iterator;
+
+  AstChildren(AstNode *const *data, size_t size) : data_(data), size_(size) {}
+
+  const_iterator begin() const {
+    return data_;
+  }
+
+  const_iterator end() const {
+    return data_ + size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return 0 == size_;
+  }
+
+  AstNode *operator[](size_t i) const {
+    return data_[i];
+  }
+
+  AstNode *at(size_t i) const {
+    if (i >= size_) {
+      throw std::out_of_range("AstChildren::at");
+    }
+    return data_[i];
+  }
+
+  AstNode *front() const {
+    return data_[0];
+  }
+
+  AstNode *back() const {
+    return data_[size_ - 1];
+  }
+
+ private:
+  AstNode *const *data_;
+  size_t size_;
+};
+
 /**
  * @brief   The node of Abstract Syntax Tree.
  *
  * @details If the node is not attached to a token, then the str will be empty,
- *          and the row and column will be SIZE_MAX.
- *          If so, then the str, row and the column will extracted
- *          from the token.
+ *          and the position will be nullptr.
+ *          If so, then the str will extracted from the token. The str only
+ *          refers to the source text, so the source text should outlive the
+ *          node. The row and column are resolved by the Ast on request.
  *
  *          The node should created by grammar parser, and the meanings of a
  *          node depends on the symbol and back-end of compiler.
@@ -22,11 +79,11 @@
 class AstNode {
  public:
   AstNode(const Symbol &symbol) : symbol_(symbol) {}
-  AstNode(Token &&token)
+  AstNode(const Token &token, const char *source)
       : symbol_(token.symbol),
-        text_(std::move(token.text)),
-        row_(token.row),
-        column_(token.column) {}
+        text_(source + token.offset),
+        length_(token.length),
+        value_(token.value) {}
 
   /**
    * @brief     Auxiliary function for debuging & printing
@@ -35,27 +92,18 @@ class AstNode {
   std::string to_string() const {
     std::ostringstream oss;
     if (symbol_.IsTerminal()) {
-      oss << "Node/T { P(" << row_ << ',' << column_ << "), " << symbol_
-          << ", " << text_ << "}";
+      oss << "Node/T { " << symbol_ << ", " << text() << "}";
     } else {
       oss << "Node/NT { " << symbol_ << " }";
     }
     return oss.str();
   }
 
-  /**
-   * @brief     Push a new child to this node
-   * @param child   new child
-   */
-  void push_child_back(AstNode *child) {
-    children_.push_back(child);
-  }
-
   /**
    * @return    All children of this node
    */
-  const std::vector<AstNode *> &children() const {
-    return children_;
+  AstChildren children() const {
+    return AstChildren(children_, children_size_);
   }
 
   /**
@@ -67,32 +115,64 @@ class AstNode {
 
   /**
    * @return    The string extracted from source code if the node attached to
-   *            a token
+   *            a token. It is materialized from the source text on request.
    */
-  const std::string &text() const {
-    return text_;
+  std::string text() const {
+    return text_ ? std::string(text_, length_) : std::string();
+  }
+
+  /**
+   * @return    The length of the token attached
+   */
+  uint32_t length() const {
+    return length_;
+  }
+
+  /**
+   * @return    The ID of the interned lexeme, such as the identifier
+   */
+  uint32_t value() const {
+    return value_;
+  }
+
+  /**
+   * @return    The value of the decoded integer literal
+   */
+  int32_t number() const {
+    return static_cast<int32_t>(value_);
   }
 
   /**
-   * @return    The row of the token attached in source code
+   * @return    The position of the token attached in source code, or nullptr
    */
-  size_t row() const {
-    return row_;
+  const char *position() const {
+    return text_;
   }
 
   /**
-    * @return    The row of the token attached in source code
-    */
-  size_t column() const {
-    return column_;
+   * @return    Whether the children are shared with another node by
+   *            hash-consing, @see Ast::HashConsExprs()
+   */
+  bool IsSharingChildren() const {
+    return children_size_ > children_capacity_;
   }
 
  private:
-  std::vector<AstNode *> children_;
+  friend class Ast;
+
+  /**
+   * @brief     The children are appended by Ast::AppendChild(), the array is
+   *            reallocated in the arena by doubling. The capacity of an array
+   *            shared from another node is 0, so that it is copied before
+   *            appending.
+   */
+  AstNode **children_{nullptr};
+  uint32_t children_size_{0};
+  uint32_t children_capacity_{0};
   Symbol symbol_;
-  std::string text_;
-  size_t row_{SIZE_MAX};
-  size_t column_{SIZE_MAX};
+  const char *text_{nullptr};
+  uint32_t length_{0};
+  uint32_t value_{0};
 };
 
 /**
@@ -100,35 +180,29 @@ class AstNode {
  *
  * @details The tree is used to contains all the node created in the parsing
  *          process. And it could manager the node momery, so could only be
- *          moved instead of coping.
+ *          moved instead of coping. The text of nodes refers to the source
+ *          text, which is not owned by the tree.
+ *
+ *          The nodes and their children arrays are placement-new'd into a
+ *          monotonic arena, and freed all at once with the tree.
  */
 class Ast {
  public:
+  static constexpr uint32_t kNoOffset = UINT32_MAX;
+
   Ast() {}
   Ast(const Ast &) = delete;
   Ast &operator=(const Ast &) = delete;
   Ast(Ast &&) = default;
   Ast &operator=(Ast &&) = default;
 
-  /**
-   * @brief     Release all the node that the ast hold
-   */
-  ~Ast() {
-    for (auto node : node_manager_) {
-      delete node;
-    }
-    node_manager_.clear();
-  }
-
   /**
    * @brief     Create a node which holds terminal symbol attached a token
    * @param token The token extracted from source code
    * @return    A ast node
    */
-  AstNode *CreateTerminal(Token &&token) {
-    auto p = new AstNode(std::move(token));
-    node_manager_.push_back(p);
-    return p;
+  AstNode *CreateTerminal(const Token &token) {
+    return arena_.Create<AstNode>(token, source_);
   }
 
   /**
@@ -137,9 +211,104 @@ class Ast {
    * @return    A ast node
    */
   AstNode *CreateNonTerminal(const Symbol &symbol) {
-    auto p = new AstNode(symbol);
-    node_manager_.push_back(p);
-    return p;
+    return arena_.Create<AstNode>(symbol);
+  }
+
+  /**
+   * @brief     Create a node of kErrorSymbol in place of the part of tree
+   *            which could not be parsed, so that the ast is still
+   *            well-formed. The ast is not complete any more.
+   * @param token The unexpected token where the syntax error is found
+   * @return    A ast node
+   */
+  AstNode *CreateError(const Token &token) {
+    Token error = token;
+    error.symbol = kErrorSymbol;
+    is_complete_ = false;
+    return arena_.Create<AstNode>(error, source_);
+  }
+
+  /**
+   * @brief     Push a new child to the node
+   * @param parent  The node created by this ast
+   * @param child   New child
+   */
+  void AppendChild(AstNode *parent, AstNode *child) {
+    if (parent->children_size_ >= parent->children_capacity_) {
+      uint32_t capacity = std::max<uint32_t>(4, parent->children_size_ * 2);
+      AstNode **children = arena_.AllocateArray<AstNode *>(capacity);
+      std::copy(parent->children_,
+                parent->children_ + parent->children_size_,
+                children);
+      parent->children_ = children;
+      parent->children_capacity_ = capacity;
+    }
+    parent->children_[parent->children_size_++] = child;
+    if (!child) {
+      is_complete_ = false;
+    }
+  }
+
+  /**
+   * @brief     Replace a range of children of the node
+   * @param parent      The node created by this ast
+   * @param first       The index of the first child replaced
+   * @param removed_num The number of children replaced
+   * @param children    The new children inserted at first
+   */
+  void ReplaceChildren(AstNode *parent,
+                       size_t first,
+                       size_t removed_num,
+                       const std::vector<AstNode *> &children);
+
+  /**
+   * @brief     Take over the nodes created by another ast, so that they could
+   *            be linked into this one. The other ast is left empty.
+   * @param other   The ast referring to the same source text
+   */
+  void Adopt(Ast &&other) {
+    arena_.Adopt(std::move(other.arena_));
+    is_complete_ = is_complete_ && other.is_complete_;
+    is_hash_consed_ = is_hash_consed_ || other.is_hash_consed_;
+    other.root_ = nullptr;
+    other.is_complete_ = true;
+    other.is_hash_consed_ = false;
+  }
+
+  /**
+   * @brief     Hash-cons the expressions, so that the structurally identical
+   *            ones share the children.
+   *
+   * @details   The sub trees without side effect, in which all the symbols
+   *            are pure, are compared by their symbols, the text of tokens
+   *            and their children. A sub tree takes the children of the first
+   *            identical one, if all its tokens are in one line. The node
+   *            itself is kept, so that its row is still of its own use site,
+   *            and the rows of the shared children are the same as the ones
+   *            in the original tree.
+   *
+   *            The shared children are linked into multiple parents, so that
+   *            the tree should not be edited after hash-consing.
+   *
+   * @param is_pure     Whether a symbol has no side effect, such as the
+   *                    operators other than assignments
+   * @return    The number of nodes sharing the children of others
+   */
+  size_t HashConsExprs(const std::function<bool(const Symbol &)> &is_pure);
+
+  /**
+   * @return    Whether some nodes share the children, @see HashConsExprs()
+   */
+  bool IsHashConsed() const {
+    return is_hash_consed_;
+  }
+
+  /**
+   * @return    Whether there is no null child or error node, which is left
+   *            by a syntax error
+   */
+  bool IsComplete() const {
+    return is_complete_;
   }
 
   /**
@@ -157,9 +326,86 @@ class Ast {
     return root_;
   }
 
+  const AstNode *root() const {
+    return root_;
+  }
+
+  /**
+   * @brief     Set the source text which the tokens are extracted from, and
+   *            index its lines
+   * @param beg     The source text, should outlive the ast
+   * @param end     The end of source text
+   */
+  void set_source(const char *beg, const char *end) {
+    source_ = beg;
+    lines_ = LineIndex(beg, end);
+  }
+
+  /**
+   * @brief     Refer the nodes to the source text after an edit. The nodes
+   *            after the edit are shifted, and the ones inside the removed
+   *            text are moved to the edit offset. The old source text is only
+   *            used to compute the offsets of nodes.
+   * @param beg     The edited source text, should outlive the ast
+   * @param end     The end of edited source text
+   * @param edit_offset     The offset where the edit happens
+   * @param removed_len     The length of old text removed
+   * @param inserted_len    The length of new text inserted
+   */
+  void EditSource(const char *beg,
+                  const char *end,
+                  uint32_t edit_offset,
+                  uint32_t removed_len,
+                  uint32_t inserted_len);
+
+  /**
+   * @return  the source text
+   */
+  const char *source() const {
+    return source_;
+  }
+
+  /**
+   * @return  the line index of source text
+   */
+  const LineIndex &lines() const {
+    return lines_;
+  }
+
+  /**
+   * @return  the offset of the token attached to the node, or kNoOffset
+   */
+  uint32_t offset(const AstNode *node) const {
+    return node->position()
+           ? static_cast<uint32_t>(node->position() - source_)
+           : kNoOffset;
+  }
+
+  /**
+   * @return  the row of the token attached to the node, or SIZE_MAX
+   */
+  size_t row(const AstNode *node) const {
+    return node->position()
+           ? lines_.Row(static_cast<uint32_t>(node->position() - source_))
+           : SIZE_MAX;
+  }
+
+  /**
+   * @return  the column of the token attached to the node, or SIZE_MAX
+   */
+  size_t column(const AstNode *node) const {
+    return node->position()
+           ? lines_.Column(static_cast<uint32_t>(node->position() - source_))
+           : SIZE_MAX;
+  }
+
  private:
   AstNode *root_{nullptr};
-  std::vector<AstNode *> node_manager_;
+  const char *source_{nullptr};
+  LineIndex lines_;
+  MonotonicArena arena_;
+  bool is_complete_{true};
+  bool is_hash_consed_{false};
 };
 
 /**
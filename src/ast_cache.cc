@@ -0,0 +1,248 @@
+//
+// Created by Dyinnz on 16-11-12.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "mapped_file.h"
+#include "ast_cache.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'L', 'I', 'K', 'E', 'A', 'S', 'T'};
+
+/**
+ * @brief   The header of cache file, followed by the sections of nodes,
+ *          symbols, line starts, name offsets, name pool and the source text.
+ *          Each section is aligned to 8 bytes.
+ */
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_size;
+  uint64_t source_hash;
+  uint64_t source_size;
+  uint32_t node_num;
+  uint32_t symbol_num;
+  uint32_t line_num;
+  uint32_t name_num;
+  uint64_t name_pool_size;
+};
+
+struct CacheSymbol {
+  int32_t id;
+  uint32_t type;
+};
+
+static_assert(std::is_trivially_copyable<FlatNode>::value,
+              "the nodes are stored as raw bytes");
+
+size_t Align(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+} // end of namespace
+
+constexpr uint32_t AstCache::kVersion;
+
+/**
+ * @see ast_cache.h
+ */
+uint64_t AstCache::HashSource(const char *source, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(source[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string AstCache::PathOf(uint64_t hash) const {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.ast",
+           static_cast<unsigned long long>(hash));
+  return dir_ + "/" + name;
+}
+
+bool AstCache::FindSymbol(int id, uint32_t type, Symbol &symbol) const {
+  for (auto &s : symbols_) {
+    if (s.ID() == id && static_cast<uint32_t>(s.type()) == type) {
+      symbol = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @see ast_cache.h
+ */
+bool AstCache::Load(const char *source,
+                    size_t size,
+                    FlatAst &ast,
+                    StringInterner *interner) const {
+  uint64_t hash = HashSource(source, size);
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(PathOf(hash)) || file->size() < sizeof(CacheHeader)) {
+    return false;
+  }
+
+  CacheHeader header;
+  memcpy(&header, file->data(), sizeof(header));
+  if (0 != memcmp(header.magic, kMagic, sizeof(kMagic))
+      || kVersion != header.version
+      || sizeof(FlatNode) != header.node_size
+      || hash != header.source_hash
+      || size != header.source_size) {
+    return false;
+  }
+
+  // take the sections in order, nullptr if the file is truncated
+  size_t pos = Align(sizeof(CacheHeader));
+  auto take_section = [&file, &pos](uint64_t bytes) -> const char * {
+    if (bytes > file->size() || pos + bytes > file->size()) {
+      return nullptr;
+    }
+    const char *section = file->data() + pos;
+    pos += Align(bytes);
+    return section;
+  };
+
+  auto nodes = reinterpret_cast<const FlatNode *>(
+      take_section(uint64_t(header.node_num) * sizeof(FlatNode)));
+  auto cache_symbols = reinterpret_cast<const CacheSymbol *>(
+      take_section(uint64_t(header.symbol_num) * sizeof(CacheSymbol)));
+  auto line_starts = reinterpret_cast<const uint32_t *>(
+      take_section(uint64_t(header.line_num) * sizeof(uint32_t)));
+  auto name_offsets = reinterpret_cast<const uint32_t *>(
+      take_section((uint64_t(header.name_num) + 1) * sizeof(uint32_t)));
+  auto name_pool = take_section(header.name_pool_size);
+  auto cache_source = take_section(header.source_size);
+  if (!nodes || !cache_symbols || !line_starts || !name_offsets || !name_pool
+      || !cache_source || 0 == header.line_num) {
+    return false;
+  }
+
+  // the hash may collide, so the source text is compared as a whole
+  if (0 != memcmp(cache_source, source, size)) {
+    return false;
+  }
+
+  FlatAst loaded;
+  for (uint32_t i = 0; i < header.symbol_num; ++i) {
+    Symbol symbol;
+    if (!FindSymbol(cache_symbols[i].id, cache_symbols[i].type, symbol)) {
+      return false;
+    }
+    loaded.symbols_.push_back(symbol);
+  }
+
+  // the nodes are used without checking, so check them once here
+  for (uint32_t i = 0; i < header.node_num; ++i) {
+    const FlatNode &node = nodes[i];
+    if (node.symbol >= header.symbol_num
+        || uint64_t(node.first_child) + node.child_num > header.node_num
+        || (FlatAst::kNoOffset != node.offset
+            && uint64_t(node.offset) + node.length > size)) {
+      return false;
+    }
+  }
+
+  // the names are interned aside, so that the interner is left untouched if
+  // the check fails partway
+  if (interner) {
+    if (0 != interner->size()) {
+      return false;
+    }
+    StringInterner names;
+    for (uint32_t i = 0; i < header.name_num; ++i) {
+      uint32_t beg = name_offsets[i];
+      uint32_t end = name_offsets[i + 1];
+      if (beg > end || end > header.name_pool_size
+          || i != names.Intern(name_pool + beg, end - beg)) {
+        return false;
+      }
+    }
+    *interner = std::move(names);
+  }
+
+  loaded.nodes_ = nodes;
+  loaded.size_ = header.node_num;
+  loaded.mapping_ = std::move(file);
+  loaded.source_ = source;
+  loaded.lines_ = LineIndex(std::vector<uint32_t>(
+      line_starts, line_starts + header.line_num));
+  ast = std::move(loaded);
+  return true;
+}
+
+/**
+ * @see ast_cache.h
+ */
+bool AstCache::Save(const char *source,
+                    size_t size,
+                    const FlatAst &ast,
+                    const StringInterner *interner) const {
+  if (!ast.IsComplete()) {
+    return false;
+  }
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.node_size = sizeof(FlatNode);
+  header.source_hash = HashSource(source, size);
+  header.source_size = size;
+  header.node_num = ast.size_;
+  header.symbol_num = static_cast<uint32_t>(ast.symbols_.size());
+  header.line_num = static_cast<uint32_t>(ast.lines_.size());
+
+  std::vector<CacheSymbol> cache_symbols;
+  for (auto &symbol : ast.symbols_) {
+    cache_symbols.push_back({symbol.ID(),
+                             static_cast<uint32_t>(symbol.type())});
+  }
+
+  std::string name_pool;
+  std::vector<uint32_t> name_offsets{0};
+  if (interner) {
+    for (uint32_t id = 0; id < interner->size(); ++id) {
+      name_pool += interner->str(id);
+      name_offsets.push_back(static_cast<uint32_t>(name_pool.size()));
+    }
+  }
+  header.name_num = static_cast<uint32_t>(name_offsets.size() - 1);
+  header.name_pool_size = name_pool.size();
+
+  // write to a temporary file, then rename it, so that a reader never sees
+  // a partial file
+  mkdir(dir_.c_str(), 0755);
+  std::string path = PathOf(header.source_hash);
+  std::string temp_path = path + "." + std::to_string(getpid()) + ".tmp";
+  std::ofstream out(temp_path, std::ios::binary);
+  auto write_section = [&out](const void *data, size_t bytes) {
+    static const char kPadding[8] = {};
+    out.write(static_cast<const char *>(data), bytes);
+    out.write(kPadding, Align(bytes) - bytes);
+  };
+
+  write_section(&header, sizeof(header));
+  write_section(ast.nodes_, sizeof(FlatNode) * ast.size_);
+  write_section(cache_symbols.data(),
+                sizeof(CacheSymbol) * cache_symbols.size());
+  write_section(ast.lines_.line_starts().data(),
+                sizeof(uint32_t) * ast.lines_.size());
+  write_section(name_offsets.data(), sizeof(uint32_t) * name_offsets.size());
+  write_section(name_pool.data(), name_pool.size());
+  write_section(source, size);
+  out.close();
+
+  if (!out || 0 != rename(temp_path.c_str(), path.c_str())) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
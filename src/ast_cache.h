@@ -0,0 +1,86 @@
+//
+// Created by Dyinnz on 16-11-12.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "flat_ast.h"
+#include "string_interner.h"
+
+/**
+ * @brief   An on-disk cache of parsed trees, keyed by the hash of source.
+ *
+ * @details Each tree is stored in a compact binary file named by the hash,
+ *          with the nodes, the dictionary of symbols, the line starts, the
+ *          interned names and a copy of the source text. The source is
+ *          compared on loading, so that a collision of hash is a miss. The
+ *          decoded literals and the IDs of names are kept in the nodes. So
+ *          that re-running an unchanged source could skip building the
+ *          tokenizer, lexing and parsing.
+ *
+ *          The file is mapped by mmap(), and the loaded tree addresses the
+ *          nodes in the mapping directly. The format is native-endian, and
+ *          a file of other version or platform is treated as missing.
+ *
+ *          The text of nodes still refers to the source text, which should
+ *          outlive the loaded tree.
+ */
+class AstCache {
+ public:
+  static constexpr uint32_t kVersion = 3;
+
+  /**
+   * @param dir     The directory of cache files, created on saving
+   * @param symbols All the symbols that could appear in the trees, used to
+   *                decode the symbols by ID
+   */
+  AstCache(std::string dir, std::vector<Symbol> symbols)
+      : dir_(std::move(dir)), symbols_(std::move(symbols)) {}
+
+  /**
+   * @brief     FNV-1a 64-bit hash
+   */
+  static uint64_t HashSource(const char *source, size_t size);
+
+  /**
+   * @return    The path of the cache file of the hash
+   */
+  std::string PathOf(uint64_t hash) const;
+
+  /**
+   * @param source      The source text, should outlive the tree
+   * @param size        The size of source text
+   * @param ast         Output the loaded tree
+   * @param interner    Output the interned names if not nullptr, which should
+   *                    be empty so that the IDs are the same, and is left
+   *                    empty if the cache is invalid
+   * @return            Whether there is a valid cache of the source
+   */
+  bool Load(const char *source,
+            size_t size,
+            FlatAst &ast,
+            StringInterner *interner = nullptr) const;
+
+  /**
+   * @param source      The source text the tree is parsed from
+   * @param size        The size of source text
+   * @param ast         The tree
+   * @param interner    The interner used by lexing, or nullptr if no name
+   *                    is stored
+   * @return            Whether succeed, an incomplete tree is not saved
+   */
+  bool Save(const char *source,
+            size_t size,
+            const FlatAst &ast,
+            const StringInterner *interner = nullptr) const;
+
+ private:
+  bool FindSymbol(int id, uint32_t type, Symbol &symbol) const;
+
+ private:
+  std::string dir_;
+  std::vector<Symbol> symbols_;
+};
@@ -61,6 +61,22 @@ TERMINAL(kNE) // !=
 NON_TERMINAL(kBlock)
 NON_TERMINAL(kIfRoot)
 
+/**
+ * @see clike_grammar.h
+ */
+const std::vector<Symbol> &ClikeSymbols() {
+  static const std::vector<Symbol> symbols{
+      kErrorSymbol,
+      kIf, kElse, kFor, kBreak, kWhile, kDo,
+      kInt, kPrintf, kIdentifier, kNumber, kString,
+      kAdd, kSub, kMul, kDiv, kAssign, kSemicolon, kComma,
+      kLT, kGT, kLeftParen, kRightParen, kLeftBrace, kRightBrace,
+      kInc, kDec, kLE, kGE, kEQ, kNE,
+      kBlock, kIfRoot,
+  };
+  return symbols;
+}
+
 /**
  * @see clike_grammar.h
  */
@@ -71,7 +87,11 @@ Tokenizer BuilderClikeTokenizer() {
       .SetLineComment("//")
       .SetBlockComment("/*", "*/")
           /* Ingore all space symbol and LF */
-      .SetIgnoreSet({kSpaceSymbol, kLFSymbol});
+      .SetIgnoreSet({kSpaceSymbol, kLFSymbol})
+          /* Compare identifiers by ID */
+      .SetInternSet({kIdentifier})
+          /* Decode number literals once */
+      .SetIntegerSet({kNumber});
 
   builder.SetPatterns(
       {
@@ -113,8 +133,7 @@ Tokenizer BuilderClikeTokenizer() {
           {">", kGT},
 
           // ID & literal
-          {R"((\d+)|(0(x|X)[a-f|A-F]+))",
-           kNumber},  //TODO Hex Number (0xabcdef)
+          {R"((\d+)|(0(x|X)[0-9a-fA-F]+))", kNumber},
           {R"("([^"]|\\")*")", kString},
           {R"(\w(\w|\d)*)", kIdentifier},
       }
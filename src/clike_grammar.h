@@ -73,10 +73,28 @@ DECLARE_SYMBOL(kNE, 36) // !=
 DECLARE_SYMBOL(kBlock, 51)
 DECLARE_SYMBOL(kIfRoot, 52)
 
+/**
+ * FIRST and FOLLOW sets of the grammar, looked up by the parser to decide
+ * with one lookahead token
+ */
+
+// Expr -> [+ -] Operand ..., Operand -> ( Expr ) | printf | id | number
+constexpr SymbolSet kExprFirst(kAddID, kSubID, kLeftParenID, kPrintfID,
+                               kIdentifierID, kNumberID);
+
+// BlockBody is ended by the } of its block, or the end of source code
+constexpr SymbolSet kBlockBodyFollow(kRightBraceID, kEofID);
+
 /**
  * @brief   Build the tokenzier for c-like programmar language
  * @return  A tokenizer
  */
 Tokenizer BuilderClikeTokenizer();
 
+/**
+ * @brief   All the symbols that could appear in the ast, including the
+ *          kErrorSymbol of null nodes. Used to decode symbols by ID.
+ */
+const std::vector<Symbol> &ClikeSymbols();
+
 } // end of namespace clike_grammar
@@ -6,7 +6,6 @@
 #include <string.h>
 #include <string>
 #include <fstream>
-#include <unordered_set>
 #include "clike_interpreter.h"
 #include "clike_grammar.h"
 #include "simplelogger.h"
@@ -15,64 +14,195 @@ using namespace simple_logger;
 using namespace clike_grammar;
 using namespace std;
 
+namespace {
+
+/**
+ * @brief   Node types of beginning of expression
+ */
+bool IsExprHead(const Symbol &symbol) {
+  switch (symbol.ID()) {
+    case kIncID:
+    case kDecID:
+    case kAddID:
+    case kSubID:
+    case kMulID:
+    case kDivID:
+    case kAssignID:
+    case kEQID:
+    case kNEID:
+    case kGEID:
+    case kGTID:
+    case kLEID:
+    case kLTID:
+    case kNumberID:
+    case kIdentifierID:
+    case kCommaID:
+    case kPrintfID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @param raw_text  The string of printf, around by ""
+ * @param args      The values of arguments, or nullptr to only count them
+ * @param arg_num   Output the number of arguments the string needs
+ * @return          The text to print
+ * @brief           Handle the escape char and the parameters
+ */
+std::string FormatPrintf(const std::string &raw_text,
+                         const int *args,
+                         uint32_t &arg_num) {
+  std::string text = "";
+  arg_num = 0;
+
+  for (size_t i = 1; i + 1 < raw_text.length(); i++) {
+    // Handle escape char
+    if (raw_text[i] == '\\') {
+      i++;
+      text += raw_text[i];
+      continue;
+    }
+
+    // Handle parameter of printf for print
+    if (raw_text[i] == '%') {
+      if (raw_text[i + 1] == '%') {
+        i++;
+        text += raw_text[i];
+        continue;
+      } else {
+        if (args) {
+          text += to_string(args[arg_num]);
+        }
+        arg_num += 1;
+        i++;
+        continue;
+      }
+    }
+    text += raw_text[i];
+  }
+
+  return text;
+}
+
+} // end of namespace
+
+constexpr size_t ClikeInterpreter::kDefaultMaxDepth;
+
 /**
  * @brief  Start interpret
  */
-void ClikeInterpreter::Exec() {
+bool ClikeInterpreter::Exec() {
   is_break_ = false;
+  is_error_ = false;
   last_line_ = 0;
-  ExecBlock(ast_.root());
+  last_line_beg_ = last_line_end_ = 0;
+  exec_stack_.clear();
+  eval_stack_.clear();
+  printf_args_.clear();
+
+  // the variables are indexed by the IDs of names, which are all the same
+  // if the identifiers are lexed without interner
+  for (uint32_t i = 0; i < ast_.size(); ++i) {
+    if (kIdentifier == ast_.symbol(i) && kNotInterned == ast_.value(i)) {
+      func_error(logger, "the identifier is not interned: {}",
+                 ast_.to_string(i));
+      return false;
+    }
+  }
+
+  if (FlatAst::kNullIndex != ast_.root()) {
+    ExecSingle(ast_.root());
+  }
+  return !is_error_;
+}
+
+/**
+ * @return  Whether there is room for one more frame
+ */
+bool ClikeInterpreter::CheckDepth() {
+  if (exec_stack_.size() + eval_stack_.size() < max_depth_) {
+    return true;
+  }
+  if (!is_error_) {
+    func_error(logger, "the nesting is deeper than {}", max_depth_);
+    is_error_ = true;
+  }
+  return false;
 }
 
 /**
  * @param node A AST node wants to interpret
  * @return  result of this line of code
- * @brief Interpret a single line
+ * @brief Interpret a single line, with the statements nested in it
  */
-int ClikeInterpreter::ExecSingle(AstNode *node) {
-  static std::unordered_set<Symbol>
-      expr_head = {   //Node types of beginning of expression
-      kInc, kDec,
-      kAdd, kSub, kMul, kDiv, kAssign,
-      kEQ, kNE, kGE, kGT, kLE, kLT,
-      kNumber, kIdentifier, kComma, kPrintf,
-  };
-
-  if (expr_head.find(node->symbol())
-      != expr_head.end()) {    //If this node means an expression
+int ClikeInterpreter::ExecSingle(uint32_t node) {
+  size_t base = exec_stack_.size();
+  int result = BeginStmt(node);
+
+  while (base < exec_stack_.size() && !is_error_) {
+    ExecFrame &frame = exec_stack_.back();
+    switch (ast_.symbol(frame.node).ID()) {
+      case kBlockID:
+        StepBlock(frame);
+        break;
+      case kIfRootID:
+        StepIfRoot(frame);
+        break;
+      case kForID:
+        StepFor(frame);
+        break;
+      case kWhileID:
+        StepWhile(frame);
+        break;
+      default:
+        StepDoWhile(frame);
+        break;
+    }
+  }
+
+  if (is_error_) {
+    exec_stack_.resize(base);
+  }
+  return result;
+}
+
+/**
+ * @param node A AST node wants to interpret
+ * @return  result of this line of code
+ * @brief   Interpret a simple statement at once, or push a frame for the
+ *          compound one
+ */
+int ClikeInterpreter::BeginStmt(uint32_t node) {
+  if (IsExprHead(ast_.symbol(node))) {    //If this node means an expression
     return EvalExpr(node);
   }
 
-  switch (node->symbol().ID()) {    //Other statement node, call its handle function
+  switch (ast_.symbol(node).ID()) {    //Other statement node, call its handle function
     case kSemicolonID:
       // empty statement
       break;
 
     case kBlockID:
-      ExecBlock(node);
+      table_.PushLevel();     //needs a new variable table level when entering a statement block
+      PushExecFrame(node, false);
       break;
 
     case kIntID:
       ExecTypeHead(node);
       break;
 
-    case kPrintfID:
-      return ExecPrintf(node);
-
     case kIfRootID:
-      ExecIfRoot(node);
-      break;
-
-    case kForID:
-      ExecFor(node);
-      break;
-
     case kWhileID:
-      ExecWhile(node);
+    case kDoID:
+      PushExecFrame(node, false);
       break;
 
-    case kDoID:
-      ExecDoWhile(node);
+    case kForID:
+      recordLine(node);
+      table_.PushLevel();   // Push a new variable table level for var definition in init statement of For
+      PushExecFrame(node, false);
       break;
 
     case kBreakID:
@@ -82,11 +212,17 @@ int ClikeInterpreter::ExecSingle(AstNode *node) {
 
     case kIfID:
     case kElseID:
-      func_error(logger, "illegal node: {}", node->to_string());
+      func_error(logger, "illegal node: {}", ast_.to_string(node));
+      break;
+
+    case kErrorID:
+      // the statement broken by a syntax error is not run
+      func_error(logger, "syntax error: {}", ast_.to_string(node));
+      is_error_ = true;
       break;
 
     default:
-      func_error(logger, "unrecognized node: {}", node->to_string());
+      func_error(logger, "unrecognized node: {}", ast_.to_string(node));
   }
 
   return 0;
@@ -94,364 +230,440 @@ int ClikeInterpreter::ExecSingle(AstNode *node) {
 
 /**
  * @param node A AST node wants to interpret
- * @brief Interpret a block of code
+ * @brief Interpret the body of a loop struct
  */
-void ClikeInterpreter::ExecBlock(AstNode *node) {
-  table_.PushLevel();     //needs a new variable table level when entering a statement block
-  for (auto child : node->children()) {
-    ExecSingle(child);
-    if (is_break_) {
-      break;
-    }
+void ClikeInterpreter::BeginLoopBody(uint32_t node) {
+  if (ast_.symbol(node) == kBlock) {
+    table_.EnterLevel();  //just raise a level instead push a new one, maybe it is running for second time
+    PushExecFrame(node, true);
+  } else {
+    BeginStmt(node);
   }
-  table_.PopLevel();    //return to lower level and delete the top one
 }
 
-/**
- * @param node A AST node wants to interpret
- * @brief Interpret a block of code of a loop struct
- */
-void ClikeInterpreter::ExecLoopBlock(AstNode *node) {
-  table_.EnterLevel();  //just raise a level instead push a new one, maybe it is running for second time
-  for (auto child : node->children()) {
-    ExecSingle(child);
-    if (is_break_) {
-      break;
-    }
+bool ClikeInterpreter::PushExecFrame(uint32_t node, bool is_loop_body) {
+  if (!CheckDepth()) {
+    return false;
   }
-  table_.LeaveLevel();  //just leave this level instead of delete one for next time get in it
+  exec_stack_.push_back({node, 0, is_loop_body});
+  return true;
 }
 
 /**
- * @param node A AST node wants to interpret
- * @brief Define a var
+ * @param frame The frame of a block
+ * @brief Interpret a block of code, one statement each step
  */
-void ClikeInterpreter::ExecTypeHead(AstNode *node) {
-  for (auto child : node->children()) {
-    if (kIdentifier == child->symbol()) {
-      table_.NewInt(child->text());     // Just define a var
-      continue;
-
-    } else if (kAssign == child->symbol()) {  //Define and init a new var
-      auto id_node = child->children().front();
-      auto expr = child->children().back();
-      auto result = EvalExpr(expr);
-
-      table_.NewInt(id_node->text(), result);
-      func_debug(logger, "name: {}, value: {}", id_node->text(), result);
-
+void ClikeInterpreter::StepBlock(ExecFrame &frame) {
+  if ((0 != frame.next && is_break_)
+      || ast_.child_num(frame.node) == frame.next) {
+    if (frame.is_loop_body) {
+      table_.LeaveLevel();  //just leave this level instead of delete one for next time get in it
     } else {
-      func_error(logger, "illegal node: {}", child->to_string());
+      table_.PopLevel();    //return to lower level and delete the top one
     }
+    exec_stack_.pop_back();
+    return;
   }
+
+  BeginStmt(ast_.child(frame.node, frame.next++));
 }
 
 /**
- * @param node A AST node wants to interpret
- * @return  result of this expr
- * @brief Interpret a expr
+ * @param frame The frame of a if root
+ * @brief Interpret [if-else if-else] struct
  */
-int ClikeInterpreter::EvalExpr(AstNode *node) {
-  recordLine(node);
-  switch (node->symbol().ID()) {
-    case kNumberID:
-      return stoi(node->text(), 0, 0);
-
-    case kIdentifierID:
-      return table_.GetInt(node->text());
-
-    case kCommaID:
-      EvalExpr(node->children().front());
-      return EvalExpr(node->children().back());
-
-    case kAssignID: {
-      auto id_name = node->children().front()->text();
-      auto result = EvalExpr(node->children().back());
-      table_.SetInt(id_name, result);
-      return result;
-    }
-
-    case kEQID:
-      return EvalExpr(node->children().front())
-          == EvalExpr(node->children().back());
-    case kNEID:
-      return EvalExpr(node->children().front())
-          != EvalExpr(node->children().back());
-
-    case kLEID:
-      return EvalExpr(node->children().front())
-          <= EvalExpr(node->children().back());
-
-    case kGEID:
-      return EvalExpr(node->children().front())
-          >= EvalExpr(node->children().back());
-
-    case kLTID:
-      return EvalExpr(node->children().front())
-          < EvalExpr(node->children().back());
-
-    case kGTID:
-      return EvalExpr(node->children().front())
-          > EvalExpr(node->children().back());
-
-    case kAddID:
-      if (1 == node->children().size()) {
-        return EvalExpr(node->children().front());
-      } else {
-        return EvalExpr(node->children().front())
-            + EvalExpr(node->children().back());
+void ClikeInterpreter::StepIfRoot(ExecFrame &frame) {
+  uint32_t node = frame.node;
+  uint32_t clause_num = ast_.child_num(node);
+
+  while (frame.next < clause_num) {
+    auto clause = ast_.child(node, frame.next++);
+
+    if (ast_.symbol(clause) == kIf) {
+      // Interpret [if-else if] struct
+      auto head = ast_.child(clause, 0);
+      auto body = ast_.children(clause).back();
+      if (EvalExpr(head)) {
+        frame.next = clause_num;
+        BeginStmt(body);
+        return;
       }
-
-    case kSubID:
-      if (1 == node->children().size()) {
-        return -EvalExpr(node->children().front());
-      } else {
-        return EvalExpr(node->children().front())
-            - EvalExpr(node->children().back());
-      }
-
-    case kMulID:
-      return EvalExpr(node->children().front())
-          * EvalExpr(node->children().back());
-
-    case kDivID:
-      return EvalExpr(node->children().front())
-          / EvalExpr(node->children().back());
-
-    case kIncID: {
-      auto result = EvalExpr(node->children().front());
-      auto id_name = node->children().front()->text();
-      table_.SetInt(id_name, table_.GetInt(id_name) + 1);
-      return result;
-    }
-
-    case kDecID: {
-      auto result = EvalExpr(node->children().front());
-      auto id_name = node->children().front()->text();
-      table_.SetInt(id_name, table_.GetInt(id_name) - 1);
-      return result;
+    } else if (ast_.symbol(clause) == kElse) {
+      // Interpret [else] struct
+      frame.next = clause_num;
+      BeginStmt(ast_.child(clause, 0));
+      return;
+    } else {
+      func_error(logger,
+                 "illegal node: {}, expect kIf or kElse",
+                 ast_.to_string(node));
     }
-
-    case kStringID:
-      return 1;   //Always return true
-
-    case kPrintfID:
-      return ExecPrintf(node);
-
-    default:
-      func_error(logger, "illegal node: {}", node->to_string());
-      return 0;
   }
+
+  exec_stack_.pop_back();
 }
 
 /**
- * @param node A AST node wants to interpret
- * @return  result of printf()
- * @brief Interpret printf()
+ * @param frame The frame of a for
+ * @brief Interpret [for] struct
+ *
+ * @details The condition and the step are expressions or ;, which never push
+ *          a frame. Step 0: init, 1: condition, 2: after the body
  */
-int ClikeInterpreter::ExecPrintf(AstNode *node) {
-  auto raw_text = node->children().front()->text();
-  auto child_iter = node->children().begin() + 1;
-
-  std::string text = "";
-
-  // Handle escape char
-  for (size_t i = 1; i < raw_text.length() - 1; i++) {
-    if (raw_text[i] == '\\') {
-      i++;
-      text += raw_text[i];
-      continue;
-    }
-
-    // Handle parameter of printf for print
-    if (raw_text[i] == '%') {
-      if (raw_text[i + 1] == '%') {
-        i++;
-        text += raw_text[i];
-        continue;
-      } else {
-        auto expr_result = EvalExpr(*child_iter);
-        child_iter++;
+void ClikeInterpreter::StepFor(ExecFrame &frame) {
+  auto node = frame.node;
+  auto init = ast_.child(node, 0);
+  auto condition = ast_.child(node, 1);
+  auto step = ast_.child(node, 2);
+  auto body = ast_.child(node, 3);
+
+  if (0 == frame.next) {
+    frame.next = 1;
+    BeginStmt(init);
+    return;
+  }
 
-        text += to_string(expr_result);
-        i++;
-        continue;
-      }
+  bool is_end = false;
+  if (2 == frame.next) {
+    if (is_break_) {
+      is_break_ = false;
+      is_end = true;
+    } else {
+      BeginStmt(step);
+      frame.next = 1;
     }
-    text += raw_text[i];
   }
 
-  // Get the length of the string ready to print.
-  // It's the return value of std::printf
-  auto result = text.length();
-
-  // Handle expression in the node of Printf
-  recordLine(node);
-  for (auto child : node->children()) {
-    EvalExpr(child);
+  if (!is_end
+      && (BeginStmt(condition) || ast_.symbol(condition) == kSemicolon)) {
+    frame.next = 2;
+    BeginLoopBody(body);
+    return;
   }
 
-  func_debug(logger, "printf return {}, val is {}", result, text);
-
-  return result;
+  if (ast_.symbol(body)
+      == kBlock) { // if it got out from a loop block, delete all higher level
+    table_.PopToNowLevel();
+  }
+  table_.PopLevel();  // Delete level for var in init statement
+  exec_stack_.pop_back();
 }
 
 /**
- * @param node A AST node wants to interpret
- * @brief Interpret [if-else if-else] struct
+ * @param frame The frame of a while
+ * @brief Interpret [while] struct
  */
-void ClikeInterpreter::ExecIfRoot(AstNode *node) {
-  for (auto clause: node->children()) {
-
-    if (clause->symbol() == kIf) {
-      if (ExecIfClause(clause)) {
-        break;
-      }
-    } else if (clause->symbol() == kElse) {
-      ExecElseClause(clause);
-      break;
-    } else {
-      func_error(logger,
-                 "illegal node: {}, expect kIf or kElse",
-                 node->to_string());
-    }
+void ClikeInterpreter::StepWhile(ExecFrame &frame) {
+  auto condition = ast_.child(frame.node, 0);
+  auto body = ast_.children(frame.node).back();
+
+  if (0 != frame.next && is_break_) {
+    is_break_ = false;
+  } else if (BeginStmt(condition)) {
+    frame.next = 1;
+    BeginLoopBody(body);
+    return;
+  }
 
+  if (ast_.symbol(body)
+      == kBlock) { // if it got out from a loop block, delete all higher level
+    table_.PopToNowLevel();
   }
+  exec_stack_.pop_back();
 }
 
 /**
- * @param node A AST node wants to interpret
- * @return result of if
- * @brief Interpret [if-else if] struct
+ * @param frame The frame of a do-while
+ * @brief Interpret [do-while] struct
  */
-int ClikeInterpreter::ExecIfClause(AstNode *node) {
-  if (kIf != node->symbol()) {
-    return 0;
-  }
-
-  int result = 0;
-  auto head = node->children().front();
-  auto body = node->children().back();
+void ClikeInterpreter::StepDoWhile(ExecFrame &frame) {
+  auto body = ast_.child(frame.node, 0);
+  auto condition = ast_.children(frame.node).back();
 
-  result = EvalExpr(head);
-
-  if (result) {
-    ExecSingle(body);
+  if (0 == frame.next) {
+    frame.next = 1;
+    BeginLoopBody(body);
+    return;
   }
-  return result;
-}
 
-/**
- * @param node A AST node wants to interpret
- * @brief Interpret [else] struct
- */
-void ClikeInterpreter::ExecElseClause(AstNode *node) {
-  if (kElse != node->symbol()) {
+  if (is_break_) {
+    is_break_ = false;
+  } else if (BeginStmt(condition)) {
+    BeginLoopBody(body);
     return;
   }
 
-  ExecSingle(node->children().front());
+  // if it got out from a loop block, delete all higher level
+  if (ast_.symbol(body) == kBlock) {
+    table_.PopToNowLevel();
+  }
+  exec_stack_.pop_back();
 }
 
 /**
  * @param node A AST node wants to interpret
- * @brief Interpret [for] struct
+ * @brief Define a var
  */
-void ClikeInterpreter::ExecFor(AstNode *node) {
-  if (kFor != node->symbol()) {
-    return;
-  }
+void ClikeInterpreter::ExecTypeHead(uint32_t node) {
+  for (auto child : ast_.children(node)) {
+    if (kIdentifier == ast_.symbol(child)) {
+      table_.NewInt(ast_.value(child));     // Just define a var
+      continue;
 
-  auto init = node->children().at(0);
-  auto condition = node->children().at(1);
-  auto step = node->children().at(2);
-  auto body = node->children().at(3);
+    } else if (kAssign == ast_.symbol(child)) {  //Define and init a new var
+      auto id_node = ast_.child(child, 0);
+      auto expr = ast_.children(child).back();
+      auto result = EvalExpr(expr);
 
-  recordLine(node);
+      table_.NewInt(ast_.value(id_node), result);
+      func_debug(logger, "name: {}, value: {}", ast_.text(id_node), result);
 
-  table_.PushLevel();   // Push a new variable table level for var definition in init statement of For
-  for (ExecSingle(init);
-       ExecSingle(condition) || condition->symbol() == kSemicolon;
-       ExecSingle(step)) {
-    if (body->symbol() == kBlock) {
-      ExecLoopBlock(body);
     } else {
-      ExecSingle(body);
-    }
-
-    if (is_break_) {
-      is_break_ = false;
-      break;
+      func_error(logger, "illegal node: {}", ast_.to_string(child));
     }
   }
+}
 
-  if (body->symbol()
-      == kBlock) { // if it got out from a loop block, delete all higher level
-    table_.PopToNowLevel();
+bool ClikeInterpreter::PushEvalFrame(uint32_t node) {
+  if (!CheckDepth()) {
+    return false;
   }
-  table_.PopLevel();  // Delete level for var in init statement
+  eval_stack_.push_back({node, 0, 0, 0});
+  return true;
 }
 
 /**
  * @param node A AST node wants to interpret
- * @brief Interpret [while] struct
+ * @return  result of this expr
+ * @brief Interpret a expr
+ *
+ * @details Each node is recorded when it is entered. A leaf is evaluated at
+ *          once, and a operator pushes a frame, then its operands are
+ *          evaluated from left to right.
+ *
+ *          The descendants of a node sharing the children are in the line
+ *          of the node, so that they are not recorded.
  */
-void ClikeInterpreter::ExecWhile(AstNode *node) {
-  if (kWhile != node->symbol()) {
-    return;
-  }
-
-  auto condition = node->children().front();
-  auto body = node->children().back();
+int ClikeInterpreter::EvalExpr(uint32_t node) {
+  size_t base = eval_stack_.size();
+  int result = 0;
+  // whether the node is to be entered, or the result is to be passed to the
+  // top frame
+  bool is_entering = true;
+  // the nodes entered above this depth are not recorded
+  size_t quiet_depth = SIZE_MAX;
+
+  while (!is_error_) {
+    if (is_entering) {
+      if (kErrorSymbol == ast_.symbol(node)) {
+        // the expression broken by a syntax error is not run
+        func_error(logger, "syntax error: {}", ast_.to_string(node));
+        is_error_ = true;
+        break;
+      }
+      if (eval_stack_.size() <= quiet_depth) {
+        recordLine(node);
+        quiet_depth = ast_.IsSharing(node) ? eval_stack_.size() : SIZE_MAX;
+      }
+      switch (ast_.symbol(node).ID()) {
+        case kNumberID:
+          result = ast_.number(node);
+          break;
+
+        case kIdentifierID:
+          result = table_.GetInt(ast_.value(node));
+          break;
+
+        case kStringID:
+          result = 1;   //Always return true
+          break;
+
+        case kAssignID:
+          // only the rhs is evaluated
+          PushEvalFrame(node);
+          node = ast_.children(node).back();
+          continue;
+
+        case kCommaID:
+        case kEQID:
+        case kNEID:
+        case kLEID:
+        case kGEID:
+        case kLTID:
+        case kGTID:
+        case kAddID:
+        case kSubID:
+        case kMulID:
+        case kDivID:
+        case kIncID:
+        case kDecID:
+          PushEvalFrame(node);
+          node = ast_.child(node, 0);
+          continue;
+
+        case kPrintfID:
+          if (!PushEvalFrame(node) || StepPrintf(eval_stack_.back(), node)) {
+            continue;
+          }
+          result = eval_stack_.back().value;
+          eval_stack_.pop_back();
+          break;
+
+        default:
+          func_error(logger, "illegal node: {}", ast_.to_string(node));
+          result = 0;
+          break;
+      }
+      is_entering = false;
+    }
 
-  while (ExecSingle(condition)) {
-    if (body->symbol() == kBlock) {
-      ExecLoopBlock(body);
-    } else {
-      ExecSingle(body);
+    if (base == eval_stack_.size()) {
+      return result;
     }
 
-    if (is_break_) {
-      is_break_ = false;
-      break;
+    // pass the result to the top frame
+    EvalFrame &frame = eval_stack_.back();
+    auto op = frame.node;
+    auto lhs_node = ast_.child(op, 0);
+    int lhs = frame.value;
+    bool is_rhs = 0 != frame.next;
+
+    switch (ast_.symbol(op).ID()) {
+      case kAssignID:
+        if (kIdentifier == ast_.symbol(lhs_node)) {
+          table_.SetInt(ast_.value(lhs_node), result);
+        }
+        break;
+
+      case kIncID:
+        if (kIdentifier == ast_.symbol(lhs_node)) {
+          table_.SetInt(ast_.value(lhs_node), result + 1);
+        }
+        break;
+
+      case kDecID:
+        if (kIdentifier == ast_.symbol(lhs_node)) {
+          table_.SetInt(ast_.value(lhs_node), result - 1);
+        }
+        break;
+
+      case kPrintfID:
+        if (frame.next <= frame.arg_num) {
+          printf_args_.push_back(result);
+        }
+        if (StepPrintf(frame, node)) {
+          is_entering = true;
+          continue;
+        }
+        result = frame.value;
+        break;
+
+      default:
+        if (!is_rhs && 2 == ast_.child_num(op)) {
+          // evaluate the rhs later
+          frame.value = result;
+          frame.next = 1;
+          node = ast_.children(op).back();
+          is_entering = true;
+          continue;
+        }
+
+        switch (ast_.symbol(op).ID()) {
+          case kCommaID:
+            break;
+          case kEQID:
+            result = lhs == result;
+            break;
+          case kNEID:
+            result = lhs != result;
+            break;
+          case kLEID:
+            result = lhs <= result;
+            break;
+          case kGEID:
+            result = lhs >= result;
+            break;
+          case kLTID:
+            result = lhs < result;
+            break;
+          case kGTID:
+            result = lhs > result;
+            break;
+          case kAddID:
+            result = is_rhs ? lhs + result : result;
+            break;
+          case kSubID:
+            result = is_rhs ? lhs - result : -result;
+            break;
+          case kMulID:
+            result = lhs * result;
+            break;
+          case kDivID:
+            result = lhs / result;
+            break;
+        }
+        break;
     }
+    eval_stack_.pop_back();
   }
 
-  if (body->symbol()
-      == kBlock) { // if it got out from a loop block, delete all higher level
-    table_.PopToNowLevel();
-  }
+  eval_stack_.resize(base);
+  return 0;
 }
 
 /**
- * @param node A AST node wants to interpret
- * @brief Interpret [do-while] struct
+ * @param frame The frame of printf
+ * @param next  Output the child to evaluate next
+ * @return      Whether to evaluate the next child, or it is finished
+ *
+ * @brief   Interpret printf(). The arguments are evaluated for the text
+ *          first, then all the children are evaluated again after the line
+ *          is recorded.
  */
-void ClikeInterpreter::ExecDoWhile(AstNode *node) {
-  if (kDo != node->symbol()) {
-    return;
-  }
+bool ClikeInterpreter::StepPrintf(EvalFrame &frame, uint32_t &next) {
+  auto node = frame.node;
+  uint32_t child_num = ast_.child_num(node);
+  auto raw_text = ast_.text(ast_.child(node, 0));
 
-  auto body = node->children().front();
-  auto condition = node->children().back();
+  if (0 == frame.next) {
+    FormatPrintf(raw_text, nullptr, frame.arg_num);
+  }
 
-  do {
-    if (body->symbol() == kBlock) {
-      ExecLoopBlock(body);
-    } else {
-      ExecSingle(body);
+  // the arguments for the text
+  while (frame.next < frame.arg_num) {
+    uint32_t index = 1 + frame.next++;
+    if (index < child_num) {
+      next = ast_.child(node, index);
+      return true;
     }
+    func_error(logger, "too few arguments: {}", ast_.to_string(node));
+    printf_args_.push_back(0);
+  }
 
-    if (is_break_) {
-      is_break_ = false;
-      break;
-    }
-  } while (ExecSingle(condition));
+  if (frame.next == frame.arg_num) {
+    frame.next += 1;
 
-  // if it got out from a loop block, delete all higher level
-  if (body->symbol() == kBlock) {
-    table_.PopToNowLevel();
+    size_t args_base = printf_args_.size() - frame.arg_num;
+    uint32_t arg_num = 0;
+    auto text = FormatPrintf(raw_text, printf_args_.data() + args_base, arg_num);
+    printf_args_.resize(args_base);
+
+    // Get the length of the string ready to print.
+    // It's the return value of std::printf
+    frame.value = static_cast<int>(text.length());
+    func_debug(logger, "printf return {}, val is {}", frame.value, text);
+
+    // Handle expression in the node of Printf
+    recordLine(node);
+  }
+
+  uint32_t index = frame.next - frame.arg_num - 1;
+  if (index < child_num) {
+    frame.next += 1;
+    next = ast_.child(node, index);
+    return true;
   }
+  return false;
 }
 
 /**
@@ -474,14 +686,29 @@ void ClikeInterpreter::OutputLines(const char *filename) {
  * @param node A AST node interpreting
  * @brief record line infomation
  */
-void ClikeInterpreter::recordLine(AstNode *node) {
-  if (last_line_ != node->row()) {
+void ClikeInterpreter::recordLine(uint32_t node) {
+  // a node without a token, such as a null child flattened, has no line
+  uint32_t offset = ast_.node(node).offset;
+  if (FlatAst::kNoOffset == offset) {
+    func_log(logger, "skip the node without line: {}", ast_.to_string(node));
+    return;
+  }
+
+  // only resolve the row if the node is out of the last line
+  size_t row = last_line_;
+  if (offset < last_line_beg_ || offset >= last_line_end_) {
+    row = ast_.row(node);
+    last_line_beg_ = ast_.lines().LineStart(row);
+    last_line_end_ = ast_.lines().LineEnd(row);
+  }
+
+  if (last_line_ != row) {
     func_log(logger,
              "now running line {}: node {}",
-             node->row(),
-             node->to_string());
-    run_lines_.push_back(node->row());
-    last_line_ = node->row();
+             row,
+             ast_.to_string(node));
+    run_lines_.push_back(row);
+    last_line_ = row;
   }
   table_.Print();
 }
@@ -5,13 +5,17 @@
 #pragma once
 
 #include <vector>
-#include "ast.h"
+#include "flat_ast.h"
 #include "variable_table.h"
 
 /**
  * @brief   C-like programming langague Interpreter
  *
  * @details A Interpreter. It traverse a AST, and do as the AST descripted.
+ *          The AST is converted to a FlatAst, so that the nodes are
+ *          addressed by index in contiguous memory. The nested statements
+ *          and expressions are executed with explicit stacks, instead of
+ *          native recursion.
  *
  *          Its constructor needs a AST's root node.
  *          When Exec() is executed, the interpreter will traverse th tree and record th line number it walked.
@@ -19,17 +23,26 @@
  */
 class ClikeInterpreter {
  public:
+  /**
+   * @brief   The default limit of nesting depth, @see set_max_depth()
+   */
+  static constexpr size_t kDefaultMaxDepth = 1 << 20;
 
   /**
    * @param A root node of the AST.
    * @brief Interpreter Constructor. Need a AST's root and ready to exec
    */
-  ClikeInterpreter(Ast &&ast) : ast_(std::move(ast)) {}
+  ClikeInterpreter(Ast &&ast) : ast_(ast) {}
+
+  ClikeInterpreter(FlatAst &&ast) : ast_(std::move(ast)) {}
 
   /**
    * @brief  Start interpret
+   * @return Whether succeed, false if it is aborted since the nesting is too
+   *         deep, a node of syntax error is reached, or the identifiers
+   *         are not interned
    */
-  void Exec();
+  bool Exec();
 
   /**
    * @param filename output file
@@ -37,45 +50,96 @@ class ClikeInterpreter {
    */
   void OutputLines(const char *filename);
 
+  /**
+   * @brief   The nesting of statements and expressions is kept in explicit
+   *          stacks on heap instead of the native stack. The depth is the
+   *          number of frames in the stacks: a nested statement or a operator
+   *          waiting for its operands takes one frame.
+   */
+  void set_max_depth(size_t max_depth) {
+    max_depth_ = max_depth;
+  }
+
+  size_t max_depth() const {
+    return max_depth_;
+  }
+
  private:
 
   /**
    * record the line number information of this node
    */
-  void recordLine(AstNode *node);
+  void recordLine(uint32_t node);
 
   /**
    * Exec statement(s)
+   *
+   * A compound statement is executed by a frame in the statement stack. Its
+   * step function is called repeatly, executes one nested statement each
+   * time, and pops the frame when finished.
    */
-  int ExecSingle(AstNode *node);
-  void ExecBlock(AstNode *node);
-  void ExecLoopBlock(AstNode *node);
+  struct ExecFrame {
+    uint32_t node;
+    uint32_t next;        // the progress of the statement
+    bool is_loop_body;    // a block as the body of loop
+  };
+
+  int ExecSingle(uint32_t node);
+  int BeginStmt(uint32_t node);
+  void BeginLoopBody(uint32_t node);
+  bool PushExecFrame(uint32_t node, bool is_loop_body);
 
   /**
    * Interprete specified syntactic structure
    */
-  void ExecTypeHead(AstNode *node);
-  int ExecPrintf(AstNode *node);
+  void ExecTypeHead(uint32_t node);
 
-  void ExecIfRoot(AstNode *node);
-  int ExecIfClause(AstNode *node);
-  void ExecElseClause(AstNode *node);
-
-  void ExecFor(AstNode *node);
-  void ExecWhile(AstNode *node);
-  void ExecDoWhile(AstNode *node);
+  void StepBlock(ExecFrame &frame);
+  void StepIfRoot(ExecFrame &frame);
+  void StepFor(ExecFrame &frame);
+  void StepWhile(ExecFrame &frame);
+  void StepDoWhile(ExecFrame &frame);
 
   /**
    * Calculate a expression
+   *
+   * A operator is evaluated by a frame in the evaluation stack, which waits
+   * for the values of its operands.
    */
-  int EvalExpr(AstNode *node);
+  struct EvalFrame {
+    uint32_t node;
+    uint32_t next;      // the number of children evaluated
+    uint32_t arg_num;   // the number of arguments of printf
+    int value;          // the value of lhs, or the result of printf
+  };
+
+  int EvalExpr(uint32_t node);
+  bool PushEvalFrame(uint32_t node);
+  bool StepPrintf(EvalFrame &frame, uint32_t &next);
+
+  bool CheckDepth();
 
 private:
-  Ast ast_;
+  FlatAst ast_;
   symbol_table::VariableTable table_;
   std::vector<size_t> run_lines_;
 
+  std::vector<ExecFrame> exec_stack_;
+  std::vector<EvalFrame> eval_stack_;
+  /**
+   * @brief   the values of the arguments of printf
+   */
+  std::vector<int> printf_args_;
+  size_t max_depth_{kDefaultMaxDepth};
+  bool is_error_{false};
+
   bool is_break_;
   std::size_t last_line_;
+  /**
+   * @brief   the offset range of last line in source text, used to avoid
+   *          resolving the row of each node
+   */
+  uint32_t last_line_beg_{0};
+  uint32_t last_line_end_{0};
 
 };
@@ -2,8 +2,8 @@
 // Created by Dyinnz on 16-10-24.
 //
 
-#include <iterator>
-#include <unordered_set>
+#include <algorithm>
+#include <thread>
 #include "simplelogger.h"
 #include "clike_grammar.h"
 #include "clike_parser.h"
@@ -13,26 +13,450 @@ using namespace simple_logger;
 
 using std::move;
 
+namespace {
+
+/**
+ * @brief   The binding powers of binary operators. The higher one binds
+ *          tighter, and the token that is not a binary operator has no power.
+ */
+enum BindingPower {
+  kNoPower = 0,
+  kCommaPower,
+  kAssignPower,     // right associative
+  kEquationPower,
+  kComparePower,
+  kAddSubPower,
+  kMulDivPower,
+};
+
+BindingPower GetBindingPower(const Symbol &symbol) {
+  // switch on the dense index, which is compiled to a lookup table
+  switch (symbol.Index()) {
+    case SymbolIndex(kCommaID):
+      return kCommaPower;
+    case SymbolIndex(kAssignID):
+      return kAssignPower;
+    case SymbolIndex(kEQID):
+    case SymbolIndex(kNEID):
+      return kEquationPower;
+    case SymbolIndex(kLTID):
+    case SymbolIndex(kGTID):
+    case SymbolIndex(kLEID):
+    case SymbolIndex(kGEID):
+      return kComparePower;
+    case SymbolIndex(kAddID):
+    case SymbolIndex(kSubID):
+      return kAddSubPower;
+    case SymbolIndex(kMulID):
+    case SymbolIndex(kDivID):
+      return kMulDivPower;
+    default:
+      return kNoPower;
+  }
+}
+
+/**
+ * @return  Whether the node of symbol has no side effect when it is
+ *          evaluated, @see Ast::HashConsExprs()
+ */
+bool IsPureExpr(const Symbol &symbol) {
+  switch (symbol.Index()) {
+    case SymbolIndex(kIdentifierID):
+    case SymbolIndex(kNumberID):
+      return true;
+    default:
+      return kNoPower != GetBindingPower(symbol) && kAssignID != symbol.ID();
+  }
+}
+
+/**
+ * @return  Whether a token is attached to any node of the sub tree
+ */
+bool HasToken(const AstNode *node) {
+  if (!node || node->position()) {
+    return nullptr != node;
+  }
+  std::vector<std::pair<const AstNode *, size_t>> stack{{node, 0}};
+  while (!stack.empty()) {
+    auto children = stack.back().first->children();
+    size_t i = stack.back().second++;
+    if (i == children.size()) {
+      stack.pop_back();
+    } else if (children[i] && children[i]->position()) {
+      return true;
+    } else if (children[i]) {
+      stack.emplace_back(children[i], 0);
+    }
+  }
+  return false;
+}
+
+/**
+ * @return  The offset of the first token in the sub tree, or kNoOffset. The
+ *          children are in source order, so only the first child with tokens
+ *          is followed.
+ *
+ * NOTICE: the ( and { are not kept in the tree, so that a statement may
+ * begin before the offset.
+ */
+uint32_t FirstOffset(const Ast &ast, const AstNode *node) {
+  uint32_t offset = Ast::kNoOffset;
+  while (node) {
+    offset = std::min(offset, ast.offset(node));
+    const AstNode *next = nullptr;
+    for (auto child : node->children()) {
+      if (HasToken(child)) {
+        next = child;
+        break;
+      }
+    }
+    node = next;
+  }
+  return offset;
+}
+
+/**
+ * @return  The first offset of the k-th statement of the block, or of the
+ *          next statement with tokens. kNoOffset if there is not.
+ */
+uint32_t StmtOffset(const Ast &ast, const AstNode *block, size_t k) {
+  auto children = block->children();
+  for (; k < children.size(); ++k) {
+    uint32_t offset = FirstOffset(ast, children[k]);
+    if (Ast::kNoOffset != offset) {
+      return offset;
+    }
+  }
+  return Ast::kNoOffset;
+}
+
+/**
+ * @return  The index of the first statement of the non-empty block, which
+ *          the text till the next statement reaches the offset
+ */
+size_t FindStmt(const Ast &ast, const AstNode *block, uint32_t offset) {
+  size_t lo = 0;
+  size_t hi = block->children().size() - 1;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (StmtOffset(ast, block, mid + 1) >= offset) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+/**
+ * @return  The nested statement of the compound statement which encloses the
+ *          offset, or nullptr
+ */
+AstNode *FindNestedStmt(const Ast &ast, AstNode *stmt, uint32_t offset) {
+  auto children = stmt->children();
+  if (children.empty()) {
+    return nullptr;
+  }
+
+  switch (stmt->symbol().ID()) {
+    case kIfRootID: {
+      // the body of the last clause beginning before the offset
+      AstNode *body = nullptr;
+      for (auto clause : children) {
+        if (!clause || ast.offset(clause) >= offset) {
+          break;
+        }
+        body = clause->children().empty() ? nullptr
+                                          : clause->children().back();
+      }
+      return body;
+    }
+    case kWhileID:
+    case kForID:
+      return children.back();
+    case kDoID:
+      return children.front();
+    default:
+      return nullptr;
+  }
+}
+
+/**
+ * @return  The block nested in a statement of the block, which encloses the
+ *          edit and could be re-parsed alone, or nullptr
+ */
+AstNode *FindInnerBlock(const Ast &ast,
+                        AstNode *block,
+                        uint32_t edit_beg,
+                        uint32_t edit_end) {
+  if (block->children().empty()) {
+    return nullptr;
+  }
+  size_t k = FindStmt(ast, block, edit_beg);
+  if (StmtOffset(ast, block, k + 1) <= edit_end) {
+    // more than one statement is edited
+    return nullptr;
+  }
+
+  AstNode *stmt = block->children()[k];
+  while (stmt && kBlock != stmt->symbol()) {
+    stmt = FindNestedStmt(ast, stmt, edit_beg);
+  }
+
+  // the edit should be after the {, and there should be two statements
+  // after the edit, so that the re-parsing could stop before the }
+  size_t size = stmt ? stmt->children().size() : 0;
+  if (size < 3
+      || StmtOffset(ast, stmt, 0) >= edit_beg
+      || StmtOffset(ast, stmt, size - 2) <= edit_end) {
+    return nullptr;
+  }
+  return stmt;
+}
+
+/**
+ * @return  The index of the token at the offset, or the size of tokens
+ */
+size_t FindToken(const std::vector<Token> &tokens, uint32_t offset) {
+  auto it = std::lower_bound(tokens.begin(), tokens.end(), offset,
+                             [](const Token &token, uint32_t offset) {
+                               return token.offset < offset;
+                             });
+  if (tokens.end() != it && offset == it->offset) {
+    return it - tokens.begin();
+  }
+  return tokens.size();
+}
+
+/**
+ * @brief   Split the tokens at the boundaries of top-level statements into
+ *          about slice_num slices of similar sizes.
+ *
+ * @details A boundary follows a ; or } at the depth 0 of braces and
+ *          parentheses, unless the next token is else or while, which may
+ *          continue the statement. So that each boundary is exact if the
+ *          tokens are well-formed.
+ *
+ * @return  The index of the first token of each slice, then tokens.size()
+ */
+std::vector<size_t> SplitTopLevel(const std::vector<Token> &tokens,
+                                  size_t slice_num) {
+  std::vector<size_t> starts{0};
+  int brace_depth = 0;
+  int paren_depth = 0;
+  for (size_t i = 0; i + 1 < tokens.size() && starts.size() < slice_num; ++i) {
+    const Symbol &symbol = tokens[i].symbol;
+    if (kLeftBrace == symbol) {
+      brace_depth += 1;
+    } else if (kRightBrace == symbol) {
+      brace_depth -= 1;
+    } else if (kLeftParen == symbol) {
+      paren_depth += 1;
+    } else if (kRightParen == symbol) {
+      paren_depth -= 1;
+    }
+
+    if ((kSemicolon != symbol && kRightBrace != symbol)
+        || 0 != brace_depth || 0 != paren_depth
+        || kElse == tokens[i + 1].symbol || kWhile == tokens[i + 1].symbol) {
+      continue;
+    }
+    if (i + 1 >= tokens.size() / slice_num * starts.size()) {
+      starts.push_back(i + 1);
+    }
+  }
+  starts.push_back(tokens.size());
+  return starts;
+}
+
+} // end of namespace
+
+constexpr size_t ClikeParser::kDefaultMaxDepth;
+constexpr size_t ClikeParser::kMinSliceSize;
+
 /**
  * @brief   This is a simple launcher function. It do some simple work.
  * @see     clike_parser.h
  */
-Ast ClikeParser::Parse(std::vector<Token> &tokens) {
-  // push a sentry in case of touch the ending iterator of tokens
-  tokens.push_back(kEofToken);
+Ast ClikeParser::Parse(const std::vector<Token> &tokens, const char *source) {
+  TokenStream stream(tokens, source);
+  return Parse(stream);
+}
+
+Ast ClikeParser::Parse(const TokenBuffer &tokens, const char *source) {
+  TokenStream stream(tokens, source);
+  return Parse(stream);
+}
+
+/**
+ * @see     clike_parser.h
+ */
+Ast ClikeParser::Parse(TokenStream &stream) {
+  // the stream produces kEofToken as a sentry at the end
+  ast_.set_source(stream.source(), stream.source_end());
+  ResetState();
 
   // launch the parsing by call ParseBlockBody(): Start -> BlockBody
-  auto p = tokens.begin();
-  auto block = ParseBlockBody(p);
+  auto block = ParseBlockBody(stream);
 
   // for debugging
   // PrintAstNode(block);
 
   // set the root and
   ast_.set_root(block);
+  if (is_hash_consing_ && ast_.IsComplete()) {
+    ast_.HashConsExprs(IsPureExpr);
+  }
   return move(ast_);
 }
 
+/**
+ * @see     clike_parser.h
+ */
+Ast ClikeParser::ParseParallel(const std::vector<Token> &tokens,
+                               const char *source,
+                               size_t thread_num,
+                               size_t min_slice_size) {
+  if (0 == thread_num) {
+    thread_num = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t slice_num = std::min(thread_num,
+                              tokens.size() / std::max<size_t>(min_slice_size,
+                                                                1));
+  std::vector<size_t> starts;
+  if (slice_num > 1) {
+    starts = SplitTopLevel(tokens, slice_num);
+  }
+  if (starts.size() <= 2) {
+    return Parse(tokens, source);
+  }
+
+  // parse each slice by a new parser, as if it is a whole program
+  struct Slice {
+    Ast ast;
+    AstNode *block{nullptr};
+    bool is_ok{false};
+  };
+  std::vector<Slice> slices(starts.size() - 1);
+  auto parse_slice = [this, &tokens, source, &starts, &slices](size_t i) {
+    ClikeParser parser;
+    parser.set_max_depth(max_depth_);
+    TokenStream stream(tokens, source, starts[i], starts[i + 1]);
+    // only the source is needed to create nodes, the lines are indexed once
+    // by the result
+    parser.ast_.set_source(source, source);
+    slices[i].block = parser.ParseBlockBody(stream);
+    slices[i].is_ok = !parser.is_error_
+        && parser.diagnostics_.empty()
+        && kEofSymbol == stream->symbol
+        && parser.ast_.IsComplete();
+    slices[i].ast = move(parser.ast_);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < slices.size(); ++i) {
+    threads.emplace_back(parse_slice, i);
+  }
+  parse_slice(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // stitch the statements in order
+  TokenStream stream(tokens, source);
+  ast_ = Ast();
+  ast_.set_source(stream.source(), stream.source_end());
+  ResetState();
+
+  auto block = ast_.CreateNonTerminal(kBlock);
+  size_t i = 0;
+  for (; i < slices.size() && slices[i].is_ok; ++i) {
+    for (auto stmt : slices[i].block->children()) {
+      ast_.AppendChild(block, stmt);
+    }
+    ast_.Adopt(move(slices[i].ast));
+  }
+
+  // the slices before end at the boundaries, so that parsing the rest
+  // serially is the same as Parse()
+  if (i < slices.size()) {
+    func_log(logger, "parse the tokens serially from slice {}", i);
+    TokenStream rest(tokens, source, starts[i]);
+    for (auto stmt : ParseBlockBody(rest)->children()) {
+      ast_.AppendChild(block, stmt);
+    }
+  }
+
+  ast_.set_root(block);
+  if (is_hash_consing_ && ast_.IsComplete()) {
+    ast_.HashConsExprs(IsPureExpr);
+  }
+  return move(ast_);
+}
+
+/**
+ * @brief   Clear the state left by the last parsing
+ */
+void ClikeParser::ResetState() {
+  stmt_stack_.clear();
+  expr_stack_.clear();
+  diagnostics_.clear();
+  is_error_ = false;
+  is_panic_ = false;
+}
+
+/**
+ * @param token     The unexpected token
+ * @param message   What is expected instead
+ * @return          A error node attached to the token
+ *
+ * @brief   Collect the syntax error and enter the panic mode. The errors in
+ *          the panic mode are only logged.
+ */
+AstNode *ClikeParser::SyntaxError(const Token &token, const char *message) {
+  func_error(logger, "{} {}", message, to_string(token));
+  if (!is_panic_) {
+    is_panic_ = true;
+    diagnostics_.push_back({token.offset,
+                            ast_.lines().Row(token.offset),
+                            ast_.lines().Column(token.offset),
+                            message});
+  }
+  return ast_.CreateError(token);
+}
+
+/**
+ * @param p Token position
+ *
+ * @brief   Leave the panic mode after a broken statement, by skipping the
+ *          tokens until after a ; or a {} block at the level where the
+ *          statement begins, or before the } closing the enclosing block.
+ *          An else following is also skipped, since it belongs to the
+ *          broken if.
+ */
+void ClikeParser::Synchronize(TokenStream &p) {
+  int depth = 0;
+  while (kEofSymbol != p->symbol
+      && !(kRightBrace == p->symbol && 0 == depth)) {
+    Symbol symbol = p->symbol;
+    ++p;
+
+    bool is_end = false;
+    if (kLeftBrace == symbol) {
+      depth += 1;
+    } else if (kRightBrace == symbol) {
+      depth -= 1;
+      is_end = 0 == depth;
+    } else if (kSemicolon == symbol) {
+      is_end = 0 == depth;
+    }
+    if (is_end && kElse != p->symbol) {
+      break;
+    }
+  }
+  is_panic_ = false;
+}
+
 /**
  * @param p Token position
  * @return  A node of declaration or definition
@@ -42,13 +466,12 @@ Ast ClikeParser::Parse(std::vector<Token> &tokens) {
  *          Part 3: rest identifier or assignment: , y , z = 0
  *          Part 4: ;
  */
-AstNode *ClikeParser::ParseTypeHead(TokenIterator &p) {
-  auto parse_decl_def = [this](TokenIterator &p) -> AstNode * {
+AstNode *ClikeParser::ParseTypeHead(TokenStream &p) {
+  auto parse_decl_def = [this](TokenStream &p) -> AstNode * {
     if (kIdentifier != p->symbol) {
-      func_error(logger, "expect a identifier {}", to_string(*p));
-      return nullptr;
+      return SyntaxError(*p, "expect a identifier");
     }
-    auto identifier = ast_.CreateTerminal(move(*p));
+    auto identifier = ast_.CreateTerminal(*p);
     ++p;
 
     if (kAssign != p->symbol) {
@@ -57,49 +480,45 @@ AstNode *ClikeParser::ParseTypeHead(TokenIterator &p) {
 
     } else {
       // There is a definition
-      auto assign = ast_.CreateTerminal(move(*p));
+      auto assign = ast_.CreateTerminal(*p);
       ++p;
 
       // only allow assign expr
-      auto expr = ParseAssignExpr(p);
+      auto expr = ParseBinaryExpr(p, kAssignPower);
 
-      assign->push_child_back(identifier);
-      assign->push_child_back(expr);
+      ast_.AppendChild(assign, identifier);
+      ast_.AppendChild(assign, expr);
       return assign;
     }
   };
 
   // Part 1: int
   if (kInt != p->symbol) {
-    func_error(logger, "expect a type {}", to_string(*p));
-    return nullptr;
+    return SyntaxError(*p, "expect a type");
   }
-  auto decl_node = ast_.CreateTerminal(move(*p));
+  auto decl_node = ast_.CreateTerminal(*p);
   ++p;
 
   // Part 2: first declaration or definition
   auto sub_node = parse_decl_def(p);
-  if (!sub_node) {
-    func_log(logger, "expect a declaration or definition {}", to_string(*p));
-    return nullptr;
+  if (kErrorSymbol == sub_node->symbol()) {
+    return sub_node;
   }
-  decl_node->push_child_back(sub_node);
+  ast_.AppendChild(decl_node, sub_node);
 
   // Part 3: rest declaration or definition
   while (kSemicolon != p->symbol) {
     // skip ,
     if (kComma != p->symbol) {
-      func_log(logger, "expect a , {}", to_string(*p));
-      return nullptr;
+      return SyntaxError(*p, "expect a , or ;");
     }
     ++p;
 
-    if (nullptr == (sub_node = parse_decl_def(p))) {
-      func_log(logger, "expect a declaration or definition {}",
-               to_string(*p));
-      return nullptr;
+    sub_node = parse_decl_def(p);
+    if (kErrorSymbol == sub_node->symbol()) {
+      return sub_node;
     }
-    decl_node->push_child_back(sub_node);
+    ast_.AppendChild(decl_node, sub_node);
   }
 
   // Part 4: skip ;
@@ -107,327 +526,222 @@ AstNode *ClikeParser::ParseTypeHead(TokenIterator &p) {
   return decl_node;
 }
 
-/**
- * @param p Token position
- * @return  A node of printf statement
- * @brief   E.g. printf("hello world %d", expr);
- *          Part 1: printf (
- *          Part 2: "hello world"
- *          Part 3: , expr or epsilon
- *          Part 4: );
- */
-AstNode *ClikeParser::ParsePrintf(TokenIterator &p) {
-  // TODO: there are some corner cases
-  // Part 1: printf (
-  if (kPrintf != p->symbol) {
-    func_error(logger, "expect a printf {}", to_string(*p));
-    return nullptr;
-  }
-  auto printf = ast_.CreateTerminal(move(*p));
-  ++p;
-
-  if (kLeftParen != p->symbol) {
-    func_error(logger, "expect a ( {}", to_string(*p));
-    return nullptr;
-  }
-  ++p;
-
-  // Part 2: a string
-  if (kString != p->symbol) {
-    func_error(logger, "expect a string {}", to_string(*p));
-    return nullptr;
-  }
-  auto str = ast_.CreateTerminal(move(*p));
-  ++p;
-  printf->push_child_back(str);
-
-  if (kComma == p->symbol) {
-    // Part 3: , expr
-    ++p; // skip the first comma
-
-    auto expr = ParseExpr(p);
-    printf->push_child_back(expr);
-
-  } else if (kRightParen == p->symbol) {
-    // Part 4: epsilon, do nothing
-  } else {
-    func_error(logger, "expect a , or ) {}", to_string(*p));
-    return nullptr;
-
-  }
-
-  // Part 4: );
-  if (kRightParen != p->symbol) {
-    func_error(logger, "expect a ) {}", to_string(*p));
-    return nullptr;
-  }
-  ++p;
-
-  return printf;
-}
-
 /**
  * @param p Token position
  * @return  A node of expression statement
  * @brief   ExprStmt -> PrintfStmt | Expr ";"
  */
-AstNode *ClikeParser::ParseExprStmt(TokenIterator &p) {
+AstNode *ClikeParser::ParseExprStmt(TokenStream &p) {
   AstNode *expr = ParseExpr(p);
   if (kSemicolon != p->symbol) {
-    func_error(logger, "expect a ; {}", to_string(*p));
-    return nullptr;
+    return SyntaxError(*p, "expect a ;");
   }
   ++p;
   return expr;
 }
 
 /**
- * @param p Token position
- * @return  A node of expresssion that may suffix with + -
- * @brief   E.g. this_is_a_var
- *               999
- *               ( a + b )
+ * @return  Whether there is room for one more frame
  */
-AstNode *ClikeParser::ParsePrimaryExpr(TokenIterator &p) {
-  if (kLeftParen == p->symbol) {
-    // begin with (
-    ++p;
-
-    auto expr = ParseExpr(p);
-
-    // end with )
-    if (kRightParen != p->symbol) {
-      func_error(logger, "expect a ) {}", to_string(*p));
-      return nullptr;
-    }
-    ++p;
-
-    return expr;
-
-  } else if (kPrintf == p->symbol) {
-    return ParsePrintf(p);
-
-  } else {
-    // begin with identifier & positive number
-    if (kNumber != p->symbol && kIdentifier != p->symbol) {
-      func_error(logger, "expect a number or identifier {}", to_string(*p));
-      ++p;
-      return nullptr;
-    }
-    auto primary = ast_.CreateTerminal(move(*p));
-    ++p;
-
-    return primary;
+bool ClikeParser::CheckDepth() {
+  if (stmt_stack_.size() + expr_stack_.size() < max_depth_) {
+    return true;
   }
-}
-
-/**
- * @param p Token position
- * @return  A node of expresssion that may suffix with + -
- * @brief   E.g. +a, -100
- */
-AstNode *ClikeParser::ParsePostfixExpr(TokenIterator &p) {
-  auto primary = ParsePrimaryExpr(p);
-
-  if (kInc == p->symbol || kDec == p->symbol) {
-    // postfix with ++ --
-    auto postfix_op = ast_.CreateTerminal(move(*p));
-    ++p;
-    postfix_op->push_child_back(primary);
-    return postfix_op;
-
-  } else {
-    // no postfix
-    return primary;
+  if (!is_error_) {
+    func_error(logger, "the nesting is deeper than {}", max_depth_);
+    is_error_ = true;
   }
+  return false;
 }
 
-/**
- * @param p Token position
- * @return  A node of expresssion that may suffix with + -
- * @brief   E.g. +a, -100
- */
-AstNode *ClikeParser::ParsePosNegExpr(TokenIterator &p) {
-  if (kAdd == p->symbol || kSub == p->symbol) {
-    // suffix with + -
-    auto posneg_op = ast_.CreateTerminal(move(*p));
-    ++p;
-    auto postfix = ParsePostfixExpr(p);
-    posneg_op->push_child_back(postfix);
-    return posneg_op;
-
-  } else {
-    // no suffix
-    return ParsePostfixExpr(p);
+bool ClikeParser::PushExprFrame(ExprFrame::Kind kind,
+                                int min_power,
+                                AstNode *opener) {
+  if (!CheckDepth()) {
+    return false;
   }
+  expr_stack_.push_back({kind, min_power, nullptr, nullptr, nullptr, opener});
+  return true;
 }
 
 /**
- * @param p Token position
- * @return  A node of expresssion that may contain * /
- * @brief   E.g. a * b / c
+ * @param p         Token position
+ * @param min_power Only the operators binding at least this power are
+ *                  accepted, the others are left to the caller
+ * @return          A node of expression that may contain binary operators
+ *
+ * @brief   Precedence climbing over the binding-power table.
+ *
+ * @details The operators of the same power are left associative, except for
+ *          the assignment, so the tree is the same as what the descent of
+ *          one function per level builds, e.g. a = b = c + d * e, f
+ *
+ *          The operand is parsed inline: it may prefix with + -, suffix with
+ *          ++ --, and be a number, a identifier, a printf or a expression
+ *          around (). Instead of recursion, the rhs of each operator, the
+ *          parenthesis and the arguments of printf push a frame, which are
+ *          popped when their expression ends.
  */
-AstNode *ClikeParser::ParseMulDivExpr(TokenIterator &p) {
-  auto curr_expr = ParsePosNegExpr(p);
-
-  while (kMul == p->symbol || kDiv == p->symbol) {
-    auto muldiv_op = ast_.CreateTerminal(move(*p));
-    ++p;
+AstNode *ClikeParser::ParseBinaryExpr(TokenStream &p, int min_power) {
+  enum Action {
+    kParseOperand,    // parse the operand of the top frame
+    kOperandDone,     // the result is the operand of the top frame
+    kRhsDone,         // the result is the rhs of pending operator
+  };
 
-    auto rhs_expr = ParsePosNegExpr(p);
-    muldiv_op->push_child_back(curr_expr);
-    muldiv_op->push_child_back(rhs_expr);
-    curr_expr = muldiv_op;
+  size_t base = expr_stack_.size();
+  if (!PushExprFrame(ExprFrame::kBinary, min_power, nullptr)) {
+    return nullptr;
   }
 
-  return curr_expr;
-}
+  Action action = kParseOperand;
+  AstNode *result = nullptr;
 
-/**
- * @param p Token position
- * @return  A node of expresssion that may contain + -
- * @brief   E.g. a + b - c
- */
-AstNode *ClikeParser::ParseAddSubExpr(TokenIterator &p) {
-  auto curr_expr = ParseMulDivExpr(p);
-
-  while (kAdd == p->symbol || kSub == p->symbol) {
-    auto addsub_op = ast_.CreateTerminal(move(*p));
-    ++p;
+  while (!is_error_) {
+    if (kParseOperand == action) {
+      // prefix with + -
+      if (kAdd == p->symbol || kSub == p->symbol) {
+        expr_stack_.back().prefix = ast_.CreateTerminal(*p);
+        ++p;
+      }
 
-    auto rhs_expr = ParseMulDivExpr(p);
-    addsub_op->push_child_back(curr_expr);
-    addsub_op->push_child_back(rhs_expr);
-    curr_expr = addsub_op;
-  }
+      if (kLeftParen == p->symbol) {
+        // begin with (, the expression is ended by )
+        ++p;
+        CheckExprFirst(p);
+        PushExprFrame(ExprFrame::kParen, kCommaPower, nullptr);
+        continue;
+
+      } else if (kPrintf == p->symbol) {
+        // printf ( "string" [, expr] )
+        result = nullptr;
+        action = kOperandDone;
+        auto printf = ast_.CreateTerminal(*p);
+        ++p;
 
-  return curr_expr;
-}
+        if (kLeftParen != p->symbol) {
+          result = SyntaxError(*p, "expect a (");
+          continue;
+        }
+        ++p;
 
-/**
- * @param p Token position
- * @return  A node of expresssion that may contain comparation
- * @brief   E.g. a < b >= c
- */
-AstNode *ClikeParser::ParseCompareExpr(TokenIterator &p) {
-  auto curr_expr = ParseAddSubExpr(p);
+        if (kString != p->symbol) {
+          result = SyntaxError(*p, "expect a string");
+          continue;
+        }
+        ast_.AppendChild(printf, ast_.CreateTerminal(*p));
+        ++p;
 
-  while (kLE == p->symbol || kGE == p->symbol
-      || kLT == p->symbol || kGT == p->symbol) {
-    auto compare_op = ast_.CreateTerminal(move(*p));
-    ++p;
+        if (kComma == p->symbol) {
+          // the arguments are ended by )
+          ++p;
+          CheckExprFirst(p);
+          PushExprFrame(ExprFrame::kPrintf, kCommaPower, printf);
+          action = kParseOperand;
 
-    auto rhs_expr = ParseAddSubExpr(p);
-    compare_op->push_child_back(curr_expr);
-    compare_op->push_child_back(rhs_expr);
-    curr_expr = compare_op;
-  }
+        } else if (kRightParen == p->symbol) {
+          ++p;
+          result = printf;
 
-  return curr_expr;
-}
+        } else {
+          result = SyntaxError(*p, "expect a , or )");
+        }
+        continue;
 
-/**
- * @param p Token position
- * @return  A node of expresssion that may contain == !=
- * @brief   E.g. a == b != c
- */
-AstNode *ClikeParser::ParseEquationExpr(TokenIterator &p) {
-  auto curr_expr = ParseCompareExpr(p);
+      } else {
+        // begin with identifier & positive number. The unexpected token is
+        // left, which may be an operator or end the statement.
+        if (kNumber != p->symbol && kIdentifier != p->symbol) {
+          result = SyntaxError(*p, "expect a number or identifier");
+        } else {
+          result = ast_.CreateTerminal(*p);
+          ++p;
+        }
+        action = kOperandDone;
+        continue;
+      }
+    }
 
-  while (kNE == p->symbol || kEQ == p->symbol) {
-    auto equation_op = ast_.CreateTerminal(move(*p));
-    ++p;
+    ExprFrame &frame = expr_stack_.back();
+    if (kOperandDone == action) {
+      // postfix with ++ --
+      if (kInc == p->symbol || kDec == p->symbol) {
+        auto postfix_op = ast_.CreateTerminal(*p);
+        ++p;
+        ast_.AppendChild(postfix_op, result);
+        result = postfix_op;
+      }
+      if (frame.prefix) {
+        ast_.AppendChild(frame.prefix, result);
+        result = frame.prefix;
+        frame.prefix = nullptr;
+      }
+      frame.lhs = result;
 
-    auto rhs_expr = ParseCompareExpr(p);
-    equation_op->push_child_back(curr_expr);
-    equation_op->push_child_back(rhs_expr);
-    curr_expr = equation_op;
-  }
+    } else {
+      ast_.AppendChild(frame.op, frame.lhs);
+      ast_.AppendChild(frame.op, result);
+      frame.lhs = frame.op;
+      frame.op = nullptr;
+    }
 
-  return curr_expr;
-}
+    int power = GetBindingPower(p->symbol);
+    if (kNoPower != power && power >= frame.min_power) {
+      frame.op = ast_.CreateTerminal(*p);
+      ++p;
 
-/**
- * @param p Token position
- * @return  A node of expression that may contain assignment
- * @brief   E.g. a = b = c
- */
-AstNode *ClikeParser::ParseAssignExpr(TokenIterator &p) {
-  std::stack<AstNode *> assign_stack;
-  // First: expr
-  auto first_expr = ParseEquationExpr(p);
-  assign_stack.push(first_expr);
-
-  // Rest: , expr ...
-  while (kAssign == p->symbol) {
-    auto assign_op = ast_.CreateTerminal(move(*p));
-    assign_stack.push(assign_op);
-    ++p;
+      // the rhs of a left associative operator binds tighter
+      int rhs_power = kAssignPower == power ? power : power + 1;
+      PushExprFrame(ExprFrame::kBinary, rhs_power, nullptr);
+      action = kParseOperand;
+      continue;
+    }
 
-    auto rhs_expr = ParseEquationExpr(p);
-    assign_stack.push(rhs_expr);
-  }
+    // the expression of the top frame ends
+    ExprFrame ended = frame;
+    expr_stack_.pop_back();
+    result = ended.lhs;
+    if (base == expr_stack_.size()) {
+      return result;
+    }
 
-  // Pop from stack
-  AstNode *curr_node = assign_stack.top();
-  assign_stack.pop();
-  while (!assign_stack.empty()) {
-    auto assign_op = assign_stack.top();
-    assign_stack.pop();
-    auto lhs_expr = assign_stack.top();
-    assign_stack.pop();
+    if (ExprFrame::kBinary == ended.kind) {
+      action = kRhsDone;
+      continue;
+    }
 
-    assign_op->push_child_back(lhs_expr);
-    assign_op->push_child_back(curr_node);
-    curr_node = assign_op;
+    if (ExprFrame::kPrintf == ended.kind) {
+      ast_.AppendChild(ended.opener, result);
+      result = ended.opener;
+    }
+    if (kRightParen != p->symbol) {
+      result = SyntaxError(*p, "expect a )");
+    } else {
+      ++p;
+    }
+    action = kOperandDone;
   }
-  return curr_node;
-}
 
-/**
- * @param p Token position
- * @return  A node of expression that may contain comma
- * @brief   E.g. expr1, expr2, expr3
- */
-AstNode *ClikeParser::ParseCommaExpr(TokenIterator &p) {
-  auto curr_expr = ParseAssignExpr(p);
-
-  while (kComma == p->symbol) {
-    auto comma_op = ast_.CreateTerminal(move(*p));
-    ++p;
+  expr_stack_.resize(base);
+  return nullptr;
+}
 
-    auto rhs_expr = ParseAssignExpr(p);
-    comma_op->push_child_back(curr_expr);
-    comma_op->push_child_back(rhs_expr);
-    curr_expr = comma_op;
+void ClikeParser::CheckExprFirst(TokenStream &p) {
+  if (!kExprFirst.Contains(p->symbol)) {
+    func_notice(logger, "expect +, -, (, printf, id, number {}",
+                to_string(*p));
   }
-
-  return curr_expr;
 }
 
 /**
  * @param p Token position
  * @return  A node of expression
- * @brief   There has 8 level of precedence
+ * @brief   There has 8 level of precedence, @see GetBindingPower()
  */
-AstNode *ClikeParser::ParseExpr(TokenIterator &p) {
-  // return ParsePrimaryExpr(p);
-  // return ParsePostfixExpr(p);
-  // return ParsePosNegExpr(p);
-  // return ParseMulDivExpr(p);
-  // return ParseAddSubExpr(p);
-  // return ParseCompareExpr(p);
-  // return ParseEquationExpr(p);
-  // return ParseAssignExpr(p);
-
+AstNode *ClikeParser::ParseExpr(TokenStream &p) {
   // check the first token
-  static std::unordered_set<Symbol> expr_firsts{
-      kAdd, kSub, kLeftParen, kIdentifier, kNumber,
-  };
-  if (expr_firsts.end() == expr_firsts.find(p->symbol)) {
-    func_notice(logger, "expect +, -, (, id, number {}", to_string(*p));
-  }
-  return ParseCommaExpr(p);
+  CheckExprFirst(p);
+  return ParseBinaryExpr(p, kCommaPower);
 }
 
 /**
@@ -437,61 +751,110 @@ AstNode *ClikeParser::ParseExpr(TokenIterator &p) {
  * @brief   Parsing single statement.
  *
  * @details A single statement could be a single expression statement,
- *          a block around
+ *          a block around, or a control structure nesting other statements.
+ *          The simple statement is parsed at once, and the compound one is
+ *          parsed by the frames in the statement stack.
  */
-AstNode *ClikeParser::ParseSingleStmt(TokenIterator &p) {
-  auto parse_break = [this](TokenIterator &p) -> AstNode * {
-    auto break_node = ast_.CreateTerminal(move(*p));
+AstNode *ClikeParser::ParseSingleStmt(TokenStream &p) {
+  auto parse_break = [this](TokenStream &p) -> AstNode * {
+    auto break_node = ast_.CreateTerminal(*p);
     ++p;
     if (kSemicolon != p->symbol) {
-      func_error(logger, "expect a ; {}", to_string(*p));
-      return nullptr;
+      return SyntaxError(*p, "expect a ;");
     }
     ++p;
     return break_node;
   };
 
-  switch (p->symbol.ID()) {
-    case kIntID:
-      return ParseTypeHead(p);
-    case kSemicolonID:
-      return ast_.CreateTerminal(move(*p++));
-    case kBreakID:
-      return parse_break(p);
-    case kDoID:
-      return ParseDoWhile(p);
-    case kWhileID:
-      return ParseWhile(p);
-    case kForID:
-      return ParseFor(p);
-    case kIfID:
-      return ParseIf(p);
-    case kLeftBraceID:
-      return ParseBraceBlock(p);
-    default:
-      return ParseExprStmt(p);
-  }
-}
+  // parse a simple statement into result, or push a frame
+  // switch on the dense index, which is compiled to a jump table
+  auto begin_stmt = [&](TokenStream &p) -> AstNode * {
+    switch (p->symbol.Index()) {
+      case SymbolIndex(kIntID):
+        return ParseTypeHead(p);
+      case SymbolIndex(kSemicolonID): {
+        auto empty_stmt = ast_.CreateTerminal(*p);
+        ++p;
+        return empty_stmt;
+      }
+      case SymbolIndex(kBreakID):
+        return parse_break(p);
+      case SymbolIndex(kDoID):
+        PushStmtFrame(StmtFrame::kDoWhile);
+        return nullptr;
+      case SymbolIndex(kWhileID):
+        PushStmtFrame(StmtFrame::kWhile);
+        return nullptr;
+      case SymbolIndex(kForID):
+        PushStmtFrame(StmtFrame::kFor);
+        return nullptr;
+      case SymbolIndex(kIfID):
+        PushStmtFrame(StmtFrame::kIf);
+        return nullptr;
+      case SymbolIndex(kLeftBraceID):
+        PushStmtFrame(StmtFrame::kBraceBlock);
+        return nullptr;
+      default:
+        return ParseExprStmt(p);
+    }
+  };
 
-AstNode *ClikeParser::ParseBraceBlock(TokenIterator &p) {
-  if (kLeftBrace != p->symbol) {
-    func_error(logger, "expect left-brace {}", to_string(*p));
-    return nullptr;
-  }
-  ++p;
+  size_t base = stmt_stack_.size();
+  AstNode *result = begin_stmt(p);
 
-  auto block = ParseBlockBody(p);
+  while (!is_error_) {
+    // a statement is parsed, skip the rest tokens if it is broken. The
+    // statement ending normally has left the panic mode.
+    if (result && is_panic_) {
+      if (kErrorSymbol == result->symbol()) {
+        Synchronize(p);
+      }
+      is_panic_ = false;
+    }
+    if (base == stmt_stack_.size()) {
+      break;
+    }
 
-  if (kRightBrace != p->symbol) {
-    func_error(logger, "expect right-brace {}", to_string(*p));
-    return nullptr;
+    StmtStep step = kFinished;
+    switch (stmt_stack_.back().kind) {
+      case StmtFrame::kBraceBlock:
+        step = StepBraceBlock(p, result);
+        break;
+      case StmtFrame::kIf:
+        step = StepIf(p, result);
+        break;
+      case StmtFrame::kFor:
+        step = StepFor(p, result);
+        break;
+      case StmtFrame::kWhile:
+        step = StepWhile(p, result);
+        break;
+      case StmtFrame::kDoWhile:
+        step = StepDoWhile(p, result);
+        break;
+    }
+
+    if (kNeedStmt == step) {
+      result = begin_stmt(p);
+
+    } else if (kNeedBraceBlock == step) {
+      result = nullptr;
+      if (kLeftBrace != p->symbol) {
+        result = SyntaxError(*p, "expect left-brace");
+      } else {
+        PushStmtFrame(StmtFrame::kBraceBlock);
+      }
+    }
   }
-  ++p;
 
-  return block;
+  if (is_error_) {
+    stmt_stack_.resize(base);
+    return nullptr;
+  }
+  return result;
 }
 
-AstNode *ClikeParser::ParseBlockBody(TokenIterator &p) {
+AstNode *ClikeParser::ParseBlockBody(TokenStream &p) {
   auto block = ast_.CreateNonTerminal(kBlock);
 
   while (true) {
@@ -500,28 +863,127 @@ AstNode *ClikeParser::ParseBlockBody(TokenIterator &p) {
       func_notice(logger, "unexpected LF {}", to_string(*p));
       ++p;
     }
-    if (kEofSymbol == p->symbol || kRightBrace == p->symbol) {
+    if (kEofSymbol == p->symbol) {
       break;
     }
-    block->push_child_back(ParseSingleStmt(p));
+    // the } closes no block, skip it
+    auto stmt = kRightBrace == p->symbol
+                ? SyntaxError(p.Next(), "unexpected right-brace")
+                : ParseSingleStmt(p);
+    if (is_error_) {
+      break;
+    }
+    is_panic_ = false;
+    ast_.AppendChild(block, stmt);
   }
 
   return block;
 }
 
+bool ClikeParser::PushStmtFrame(StmtFrame::Kind kind) {
+  if (!CheckDepth()) {
+    return false;
+  }
+  stmt_stack_.push_back({kind, 0, nullptr, nullptr});
+  return true;
+}
+
 /**
- * @param p Token position
- * @return  A node of if-root
+ * @brief   Pop the top frame
+ * @param node    The node of the compound statement, or a error node
+ */
+ClikeParser::StmtStep ClikeParser::FinishStmtFrame(AstNode *node,
+                                                   AstNode *&result) {
+  stmt_stack_.pop_back();
+  result = node;
+  return kFinished;
+}
+
+/**
+ * @param p       Token position
+ * @param result  The nested statement just parsed
+ * @return        The next step
+ * @brief         { multi-statement }
  */
-AstNode *ClikeParser::ParseIf(TokenIterator &p) {
-  auto parse_if_clause = [this](TokenIterator &p) -> AstNode * {
+ClikeParser::StmtStep ClikeParser::StepBraceBlock(TokenStream &p,
+                                                  AstNode *&result) {
+  StmtFrame &frame = stmt_stack_.back();
+  if (0 == frame.state) {
+    // skip {, which is checked by caller
+    ++p;
+    frame.node = ast_.CreateNonTerminal(kBlock);
+    frame.state = 1;
+  } else {
+    ast_.AppendChild(frame.node, result);
+  }
+
+  // check whether there are some LFs
+  while (kLFSymbol == p->symbol) {
+    func_notice(logger, "unexpected LF {}", to_string(*p));
+    ++p;
+  }
+  if (!kBlockBodyFollow.Contains(p->symbol)) {
+    return kNeedStmt;
+  }
+
+  if (kRightBrace != p->symbol) {
+    return FinishStmtFrame(SyntaxError(*p, "expect right-brace"), result);
+  }
+  ++p;
+
+  return FinishStmtFrame(frame.node, result);
+}
+
+/**
+ * @param p       Token position
+ * @param result  The nested statement just parsed
+ * @return        The next step
+ * @brief         if (expr) stmt [else if (expr) stmt]... [else stmt]
+ *
+ * @details State 0: begin, 1: the body of if clause, 2: the body of else
+ */
+ClikeParser::StmtStep ClikeParser::StepIf(TokenStream &p, AstNode *&result) {
+  StmtFrame &frame = stmt_stack_.back();
+  if (0 == frame.state) {
+    frame.node = ast_.CreateNonTerminal(kIfRoot);
+  } else {
+    ast_.AppendChild(frame.clause, result);
+    ast_.AppendChild(frame.node, frame.clause);
+    if (2 == frame.state) {
+      return FinishStmtFrame(frame.node, result);
+    }
+  }
+
+  // whether a if clause is parsed, which may be followed by else
+  bool has_clause = 0 != frame.state;
+
+  while (true) {
+    if (has_clause) {
+      if (kElse != p->symbol) {
+        // the next token does not belong to if
+        break;
+      }
+      if (kIf != p.Peek(1).symbol) {
+        frame.clause = ast_.CreateTerminal(*p);
+        ++p;
+        frame.state = 2;
+        return kNeedStmt;
+      }
+      // skip else
+      ++p;
+    }
+    if (kIf != p->symbol) {
+      break;
+    }
+    has_clause = true;
+
     // if token
-    auto clause = ast_.CreateTerminal(move(*p));
+    auto clause = ast_.CreateTerminal(*p);
     ++p;
 
+    // the whole if is broken if a clause is wrong
     if (kLeftParen != p->symbol) {
-      func_error(logger, "expect a ( {}", to_string(*p));
-      return nullptr;
+      return FinishStmtFrame(SyntaxError(*p, "expect a ("), result);
     }
     ++p;
 
@@ -529,205 +991,349 @@ AstNode *ClikeParser::ParseIf(TokenIterator &p) {
     auto head = ParseExpr(p);
 
     if (kRightParen != p->symbol) {
-      func_error(logger, "expect a ) {}", to_string(*p));
-      return nullptr;
+      return FinishStmtFrame(SyntaxError(*p, "expect a )"), result);
     }
     ++p;
 
     // Executable body
-    auto body = ParseSingleStmt(p);
-
-    clause->push_child_back(head);
-    clause->push_child_back(body);
-    return clause;
-  };
-
-  // check
-  if (kIf != p->symbol) {
-    func_error(logger, "expect a if {}", to_string(*p));
-    return nullptr;
+    ast_.AppendChild(clause, head);
+    frame.clause = clause;
+    frame.state = 1;
+    return kNeedStmt;
   }
 
-  auto if_root = ast_.CreateNonTerminal(kIfRoot);
-
-  while (kIf == p->symbol) {
-    auto clause = parse_if_clause(p);
-    if_root->push_child_back(clause);
-
-    if (kElse == p->symbol) {
-      if (kIf == next(p)->symbol) {
-        // skip else
-        ++p;
-      } else {
-        auto else_clause = ast_.CreateTerminal(move(*p));
-        ++p;
-
-        auto else_body = ParseSingleStmt(p);
-        else_clause->push_child_back(else_body);
-        if_root->push_child_back(else_clause);
-        break;
-      }
-    } else {
-      // the next token does not belong to if
-      break;
-    }
-  }
-  return if_root;
+  return FinishStmtFrame(frame.node, result);
 }
 
 /**
- * @param p Token position
- * @return  A node of for
+ * @param p       Token position
+ * @param result  The nested statement just parsed
+ * @return        The next step
  *
  * @brief   Parsing for structure
  * @details There are three pseudo expression in for: Init, Condition, Step.
  *          Init could be any statement,
  *          Condition could be only be expr statement,
  *          Step could to be only be expr statement.
+ *
+ *          State 0: begin, 1: the init, 2: the body
  */
-AstNode *ClikeParser::ParseFor(TokenIterator &p) {
-  if (kFor != p->symbol) {
-    func_error(logger, "expect a for {}", to_string(*p));
-    return nullptr;
-  }
-  auto for_node = ast_.CreateTerminal(move(*p));
-  ++p;
+ClikeParser::StmtStep ClikeParser::StepFor(TokenStream &p, AstNode *&result) {
+  StmtFrame &frame = stmt_stack_.back();
+  auto for_node = frame.node;
 
-  if (kLeftParen != p->symbol) {
-    func_error(logger, "expect a ( {}", to_string(*p));
-    return nullptr;
+  if (0 == frame.state) {
+    for_node = frame.node = ast_.CreateTerminal(*p);
+    ++p;
+
+    if (kLeftParen != p->symbol) {
+      return FinishStmtFrame(SyntaxError(*p, "expect a ("), result);
+    }
+    ++p;
+
+    // first expression with ;
+    frame.state = 1;
+    return kNeedStmt;
+
+  } else if (2 == frame.state) {
+    ast_.AppendChild(for_node, result);
+    return FinishStmtFrame(for_node, result);
   }
-  ++p;
 
-  // first expression with ;
-  auto init = ParseSingleStmt(p);
+  auto init = result;
 
   // second expression with ;
   AstNode *condition = nullptr;
   if (kSemicolon == p->symbol) {
     // empty condition
-    condition = ast_.CreateTerminal(Token(*p));
-    ++p;
+    condition = ast_.CreateTerminal(*p);
   } else {
     // expression condition
     condition = ParseExpr(p);
     if (kSemicolon != p->symbol) {
-      func_error(logger, "expect a ; {}", to_string(*p));
-      return nullptr;
+      return FinishStmtFrame(SyntaxError(*p, "expect a ;"), result);
     }
-    ++p;
   }
+  // the empty step is attached to this ;
+  Token condition_end = p.Next();
 
   // third expression with )
   AstNode *step = nullptr;
   if (kRightParen == p->symbol) {
-    step = ast_.CreateTerminal(Token(*prev(p)));
+    step = ast_.CreateTerminal(condition_end);
   } else {
     step = ParseExpr(p);
   }
 
   if (kRightParen != p->symbol) {
-    func_error(logger, "expect a ) {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a )"), result);
   }
   ++p;
 
-  auto body = ParseSingleStmt(p);
-
-  // construct for node
-  for_node->push_child_back(init);
-  for_node->push_child_back(condition);
-  for_node->push_child_back(step);
-  for_node->push_child_back(body);
-  return for_node;
+  // construct for node, then the body
+  ast_.AppendChild(for_node, init);
+  ast_.AppendChild(for_node, condition);
+  ast_.AppendChild(for_node, step);
+  frame.state = 2;
+  return kNeedStmt;
 }
 
 /**
- * @param p Token position
- * @return  A node of while
+ * @param p       Token position
+ * @param result  The nested statement just parsed
+ * @return        The next step
  *          while (expr) {      // Part 1
  *            multi-statement   // Part 2
  *          }
  */
-AstNode *ClikeParser::ParseWhile(TokenIterator &p) {
-  // Part 1
-  if (kWhile != p->symbol) {
-    func_error(logger, "expect a while {}", to_string(*p));
-    return nullptr;
+ClikeParser::StmtStep ClikeParser::StepWhile(TokenStream &p,
+                                             AstNode *&result) {
+  StmtFrame &frame = stmt_stack_.back();
+  if (0 != frame.state) {
+    // Part 2
+    ast_.AppendChild(frame.node, result);
+    return FinishStmtFrame(frame.node, result);
   }
-  auto while_node = ast_.CreateTerminal(move(*p));
+
+  // Part 1
+  auto while_node = ast_.CreateTerminal(*p);
   ++p;
 
   if (kLeftParen != p->symbol) {
-    func_error(logger, "expect a ( {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a ("), result);
   }
   ++p;
 
   auto condition = ParseExpr(p);
 
   if (kRightParen != p->symbol) {
-    func_error(logger, "expect a ) {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a )"), result);
   }
   ++p;
 
-  // Part 2
-  auto body = ParseSingleStmt(p);
-
-  // construct while node
-  while_node->push_child_back(condition);
-  while_node->push_child_back(body);
-  return while_node;
+  // construct while node, then the body
+  ast_.AppendChild(while_node, condition);
+  frame.node = while_node;
+  frame.state = 1;
+  return kNeedStmt;
 }
 
 /**
- * @param p Token position
- * @return  A node of do while
+ * @param p       Token position
+ * @param result  The nested statement just parsed
+ * @return        The next step
  *          do {                    // Part 1
  *            multi-statement       // Part 2
  *          } while (expr);         // Part 3
  */
-AstNode *ClikeParser::ParseDoWhile(TokenIterator &p) {
-  // Part 1
-  if (kDo != p->symbol) {
-    func_error(logger, "expect a do {}", to_string(*p));
-    return nullptr;
-  }
-  auto do_node = ast_.CreateTerminal(move(*p));
-  ++p;
+ClikeParser::StmtStep ClikeParser::StepDoWhile(TokenStream &p,
+                                               AstNode *&result) {
+  StmtFrame &frame = stmt_stack_.back();
+  if (0 == frame.state) {
+    // Part 1
+    frame.node = ast_.CreateTerminal(*p);
+    ++p;
 
-  // Part 2
-  auto body = ParseBraceBlock(p);
+    // Part 2
+    frame.state = 1;
+    return kNeedBraceBlock;
+  }
+  auto do_node = frame.node;
+  auto body = result;
 
   // Part 3
   if (kWhile != p->symbol) {
-    func_error(logger, "expect a while {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a while"), result);
   }
   ++p;
 
   if (kLeftParen != p->symbol) {
-    func_error(logger, "expect a ( {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a ("), result);
   }
   ++p;
 
   auto condition = ParseExpr(p);
 
   if (kRightParen != p->symbol) {
-    func_error(logger, "expect a ) {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a )"), result);
   }
   ++p;
   if (kSemicolon != p->symbol) {
-    func_error(logger, "expect a ; {}", to_string(*p));
-    return nullptr;
+    return FinishStmtFrame(SyntaxError(*p, "expect a ;"), result);
   }
   ++p;
 
   // construct the do-while node
-  do_node->push_child_back(body);
-  do_node->push_child_back(condition);
-  return do_node;
+  ast_.AppendChild(do_node, body);
+  ast_.AppendChild(do_node, condition);
+  return FinishStmtFrame(do_node, result);
+}
+
+/**
+ * @see clike_parser.h
+ */
+bool ClikeParser::Reparse(Ast &ast,
+                          const std::vector<Token> &tokens,
+                          const char *source,
+                          uint32_t edit_offset,
+                          uint32_t removed_len,
+                          uint32_t inserted_len) {
+  ast_ = move(ast);
+  ResetState();
+
+  TokenStream stream(tokens, source);
+  const uint32_t edit_end = edit_offset + inserted_len;
+
+  // the blocks from the root to the smallest one enclosing the edit. The
+  // statements of an ast with syntax errors may not be contiguous, and the
+  // nodes of a hash-consed ast are shared, so that it is parsed again as a
+  // whole.
+  std::vector<AstNode *> blocks;
+  if (ast_.IsComplete() && !ast_.IsHashConsed()) {
+    // from now on, the offsets are in the edited source text
+    ast_.EditSource(stream.source(), stream.source_end(),
+                    edit_offset, removed_len, inserted_len);
+    for (auto block = ast_.root(); block;
+         block = FindInnerBlock(ast_, block, edit_offset, edit_end)) {
+      blocks.push_back(block);
+    }
+  }
+
+  ReparseResult result = kParseAll;
+  while (!blocks.empty()) {
+    result = ReparseBlock(tokens, blocks.back(), 1 == blocks.size(),
+                          edit_offset, edit_end);
+    if (kRetryOuter != result) {
+      break;
+    }
+    blocks.pop_back();
+  }
+
+  if (kSpliced == result) {
+    if (is_hash_consing_ && ast_.IsComplete()) {
+      ast_.HashConsExprs(IsPureExpr);
+    }
+    ast = move(ast_);
+    return true;
+  }
+
+  func_log(logger, "parse all the tokens again");
+  ast_ = Ast();
+  ast = Parse(stream);
+  return false;
+}
+
+/**
+ * @param tokens    The edited tokens
+ * @param block     The block enclosing the edit
+ * @param is_root   Whether the block is the root, which is ended by EOF
+ * @param edit_beg  The offset where the edit begins
+ * @param edit_end  The offset where the inserted text ends
+ * @return          The result
+ *
+ * @brief   Parse the statements of block from the one at the edit, and
+ *          reuse the old statements after the edit.
+ *
+ * @details The first token of a statement may be a ( or {, which is not kept
+ *          in the tree. So that a statement could be a boundary only if the
+ *          token before it is the ; or } ending the previous statement, or
+ *          the { of the block.
+ *
+ *          The re-parsing begins before the statement at the edit, at such a
+ *          boundary before the edit. It is also not after an if, whose else
+ *          may be inserted.
+ *
+ *          The re-parsing ends if the new statements end where an old
+ *          statement begins, and the old statement before it begins at a
+ *          token after the edit. The tokens from that token are the same as
+ *          the old ones, so that the old statements are also the same.
+ */
+ClikeParser::ReparseResult ClikeParser::ReparseBlock(
+    const std::vector<Token> &tokens,
+    AstNode *block,
+    bool is_root,
+    uint32_t edit_beg,
+    uint32_t edit_end) {
+  auto children = block->children();
+  auto is_boundary = [&](size_t k, size_t &token_pos) {
+    uint32_t offset = FirstOffset(ast_, children[k]);
+    token_pos = FindToken(tokens, offset);
+    if (0 == token_pos || tokens.size() == token_pos) {
+      return false;
+    }
+    // a { before a statement other than block is the { of enclosing block
+    const Symbol &prev = tokens[token_pos - 1].symbol;
+    return kSemicolon == prev || kRightBrace == prev
+        || (kLeftBrace == prev && kBlock != children[k]->symbol());
+  };
+  auto is_after_if = [&](size_t k) {
+    return k > 0 && children[k - 1] && kIfRoot == children[k - 1]->symbol();
+  };
+
+  size_t first = children.empty() ? 0 : FindStmt(ast_, block, edit_beg);
+  size_t token_pos = 0;
+  while (!(is_root && 0 == first)) {
+    if (!is_after_if(first)
+        && FirstOffset(ast_, children[first]) < edit_beg
+        && is_boundary(first, token_pos)) {
+      break;
+    }
+    if (0 == first) {
+      return kRetryOuter;
+    }
+    first -= 1;
+  }
+  if (is_root && 0 == first) {
+    token_pos = 0;
+  }
+
+  // the index of old statement to be reused
+  size_t reuse = first + 1;
+  auto is_reusable = [&](uint32_t offset) {
+    uint32_t prev_offset = FirstOffset(ast_, children[reuse - 1]);
+    return offset == FirstOffset(ast_, children[reuse])
+        && Ast::kNoOffset != prev_offset && prev_offset > edit_end
+        && FindToken(tokens, prev_offset) < tokens.size();
+  };
+
+  // the old statements reused have no syntax error, so that the errors of
+  // the new ones are all the diagnostics
+  diagnostics_.clear();
+  TokenStream p(tokens, ast_.source(), token_pos);
+  std::vector<AstNode *> stmts;
+  while (true) {
+    // check whether there are some LFs
+    while (kLFSymbol == p->symbol) {
+      func_notice(logger, "unexpected LF {}", to_string(*p));
+      ++p;
+    }
+    if (kBlockBodyFollow.Contains(p->symbol)) {
+      if (!is_root) {
+        return kRetryOuter;
+      }
+      if (kEofSymbol != p->symbol) {
+        // a stray } is a syntax error of the root
+        return kParseAll;
+      }
+      reuse = children.size();
+      break;
+    }
+
+    while (reuse < children.size()
+        && StmtOffset(ast_, block, reuse) < p->offset) {
+      reuse += 1;
+    }
+    if (reuse < children.size() && is_reusable(p->offset)) {
+      break;
+    }
+
+    auto stmt = ParseSingleStmt(p);
+    if (is_error_) {
+      return kParseAll;
+    }
+    stmts.push_back(stmt);
+  }
+
+  ast_.ReplaceChildren(block, first, reuse - first, stmts);
+  return kSpliced;
 }
@@ -4,8 +4,20 @@
 
 #pragma once
 
-#include <stack>
+#include <string>
+#include <vector>
 #include "ast.h"
+#include "token_stream.h"
+
+/**
+ * @brief   A syntax error found by the parser
+ */
+struct ParseDiagnostic {
+  uint32_t offset;      // the offset of the unexpected token
+  size_t row;
+  size_t column;
+  std::string message;
+};
 
 /**
  * @brief   C-like programming langague Parser
@@ -14,71 +26,276 @@
  *          according to the BNF-Grammar defined in the documentation.
  *          @see doc/bnf-grammar.exel
  *
+ *          The descent into nested statements and expressions uses explicit
+ *          stacks, instead of native recursion.
+ *
  *          When Parse() is executed, the parser holds an ast inside, and
  *          move it to caller on returning. So that the parser is stateless,
  *          which could be called repeatly.
+ *
+ *          The identifiers should be interned by the tokenizer, so that the
+ *          ast could be interpreted.
+ *
+ *          The parser recovers from syntax errors by panic mode, so that all
+ *          the errors of a program are reported by one pass. The part which
+ *          could not be parsed is replaced by a node of kErrorSymbol, and the
+ *          tokens are skipped until the end of the broken statement.
+ *          @see diagnostics()
  */
 class ClikeParser {
-  typedef std::vector<Token>::iterator TokenIterator;
-
  public:
+  /**
+   * @brief   The default limit of nesting depth, @see set_max_depth()
+   */
+  static constexpr size_t kDefaultMaxDepth = 1 << 20;
+
   /**
    * @brief   This is a simple launcher function. It do some simple work.
    *
    * @param tokens  Tokens extracted by tokenizer from sources code
+   * @param source  The source code, should outlive the ast
+   * @return        The ast
+   */
+  Ast Parse(const std::vector<Token> &tokens, const char *source);
+
+  /**
+   * @param tokens  Tokens stored in the arrays of buffer
+   * @param source  The source code, should outlive the ast
    * @return        The ast
    */
-  Ast Parse(std::vector<Token> &tokens);
+  Ast Parse(const TokenBuffer &tokens, const char *source);
+
+  /**
+   * @brief   Parse the tokens pulled from a token stream, so that the lexing
+   *          and parsing could run as one pass.
+   *
+   * @param stream  Token stream, its source code should outlive the ast
+   * @return        The ast
+   */
+  Ast Parse(TokenStream &stream);
+
+  /**
+   * @brief   Parse the top-level statements by multiple threads.
+   *
+   * @details The tokens are splited at the boundaries of top-level
+   *          statements, found by a linear pre-scan counting the braces and
+   *          parentheses. The slices are parsed in parallel, each into the
+   *          arena of its own ast, then the statements are stitched into the
+   *          root block in order.
+   *
+   *          The result is always the same as Parse(). If a slice does not
+   *          end exactly at its boundary, such as there is a syntax error,
+   *          the tokens from this slice are parsed again serially. So the
+   *          errors in these tokens may be logged twice, but they are only
+   *          collected once in the diagnostics.
+   *
+   * @param tokens  Tokens extracted by tokenizer from sources code
+   * @param source  The source code, should outlive the ast
+   * @param thread_num      The number of threads, 0 means the hardware
+   *                        concurrency
+   * @param min_slice_size  The tokens are parsed serially if they could not
+   *                        be splited into slices larger than this
+   * @return        The ast
+   */
+  Ast ParseParallel(const std::vector<Token> &tokens,
+                    const char *source,
+                    size_t thread_num = 0,
+                    size_t min_slice_size = kMinSliceSize);
+
+  static constexpr size_t kMinSliceSize = 1 << 16;
+
+  /**
+   * @brief   Re-parse only the statements affected by an edit of source text,
+   *          and splice them into the ast parsed before the edit.
+   *
+   * @details The smallest block enclosing the edit is found by the offsets
+   *          of nodes. The statements of the block are parsed again from the
+   *          one at the edit, until the new statements end where an old
+   *          statement after the edit begins, and the rest old statements are
+   *          reused. If the block ends before that, such as the braces are
+   *          edited, the outer block is tried.
+   *
+   *          The result is always the same as Parse(). The statements of an
+   *          ast with syntax errors may not be contiguous, so that such an
+   *          ast is parsed again as a whole.
+   *
+   * @param ast     The ast parsed before the edit, updated in place
+   * @param tokens  The tokens updated by Tokenizer::Relex()
+   * @param source  The edited source text, should outlive the ast
+   * @param edit_offset     The offset where the edit happens
+   * @param removed_len     The length of old text removed
+   * @param inserted_len    The length of new text inserted
+   * @return        Whether the old statements are reused, or the whole ast
+   *                is parsed again
+   */
+  bool Reparse(Ast &ast,
+               const std::vector<Token> &tokens,
+               const char *source,
+               uint32_t edit_offset,
+               uint32_t removed_len,
+               uint32_t inserted_len);
+
+  /**
+   * @brief   The nesting of statements and expressions is kept in explicit
+   *          stacks on heap instead of the native stack, so that a deep
+   *          nesting does not overflow the native stack. The depth is the
+   *          number of frames in the stacks: a nested statement, an opening
+   *          parenthesis or a pending binary operator takes one frame.
+   *
+   *          The parsing is aborted with an error if the depth exceeds the
+   *          limit.
+   */
+  void set_max_depth(size_t max_depth) {
+    max_depth_ = max_depth;
+  }
+
+  size_t max_depth() const {
+    return max_depth_;
+  }
+
+  /**
+   * @brief   Hash-cons the identical expressions without side effect after
+   *          parsing, so that they share the nodes, @see Ast::HashConsExprs()
+   *
+   *          A hash-consed ast could not be edited, so that it is parsed
+   *          again as a whole by Reparse(). The ast with syntax errors is
+   *          not hash-consed, since it is not to be run.
+   */
+  void set_hash_consing(bool is_hash_consing) {
+    is_hash_consing_ = is_hash_consing;
+  }
+
+  bool is_hash_consing() const {
+    return is_hash_consing_;
+  }
+
+  /**
+   * @return  Whether the last parsing is aborted, since the nesting is
+   *          deeper than the max depth
+   */
+  bool IsError() const {
+    return is_error_;
+  }
+
+  /**
+   * @return  The syntax errors of the last parsing in order. Only the first
+   *          error of a broken statement is collected, the following ones
+   *          found before the recovery are likely caused by it.
+   */
+  const std::vector<ParseDiagnostic> &diagnostics() const {
+    return diagnostics_;
+  }
 
  private:
   /**
-   * All the parsing functions accept a TokenIterator refenrece, creating
+   * All the parsing functions accept a TokenStream refenrece, creating
    * a AstNode when finishing its work, and return it to called.
    *
-   * All the parsing functions will modify the TokenIterator. After functions
+   * All the parsing functions will modify the TokenStream. After functions
    * finish recognizing their parts, they will leave the token unrecognized to
    * their caller.
    *
-   * All the parsing functions will return nullptr if they do not accept
-   * following tokens.
+   * All the parsing functions will return a node of kErrorSymbol if they do
+   * not accept following tokens, and enter the panic mode. The statement
+   * parsing skips the tokens of a broken statement, then the panic mode is
+   * left. Only the abort by nesting depth returns nullptr.
    */
+  AstNode *SyntaxError(const Token &token, const char *message);
+  void Synchronize(TokenStream &p);
+  void ResetState();
 
   /**
    * Block statement & auxilary parsing function
    */
-  AstNode *ParseBlockBody(TokenIterator &p); // the block without {}
-  AstNode *ParseBraceBlock(TokenIterator &p); // the block with {}
-  AstNode *ParseSingleStmt(TokenIterator &p);
+  AstNode *ParseBlockBody(TokenStream &p); // the block without {}
+  AstNode *ParseSingleStmt(TokenStream &p);
 
   /**
    * Simple statement
    */
-  AstNode *ParseTypeHead(TokenIterator &p); // int x, y = 1;
-  AstNode *ParsePrintf(TokenIterator &p);
-  AstNode *ParseExprStmt(TokenIterator &p); // any expr ending with ;
+  AstNode *ParseTypeHead(TokenStream &p); // int x, y = 1;
+  AstNode *ParseExprStmt(TokenStream &p); // any expr ending with ;
+
+  /**
+   * Expression, 9 levels of precedence. The binary operators are parsed by
+   * precedence climbing, instead of one function per level.
+   */
+  AstNode *ParseBinaryExpr(TokenStream &p, int min_power);
+  AstNode *ParseExpr(TokenStream &p);
+  void CheckExprFirst(TokenStream &p);
+
+  /**
+   * Compound statement, which nests other statements.
+   *
+   * A compound statement is parsed by a frame in the statement stack. The
+   * step function of the frame is called first with state 0, then once for
+   * each nested statement it asks for, until it is finished.
+   */
+  enum StmtStep {
+    kNeedStmt,        // parse a nested statement and pass it to the frame
+    kNeedBraceBlock,  // the same, but the statement must be a {} block
+    kFinished,        // the frame is popped and its node is the result
+  };
+
+  struct StmtFrame {
+    enum Kind { kBraceBlock, kIf, kFor, kWhile, kDoWhile };
+
+    Kind kind;
+    int state;
+    AstNode *node;    // the node of the compound statement
+    AstNode *clause;  // the pending if or else clause
+  };
+
+  bool PushStmtFrame(StmtFrame::Kind kind);
+  StmtStep FinishStmtFrame(AstNode *node, AstNode *&result);
+
+  StmtStep StepBraceBlock(TokenStream &p, AstNode *&result);
+  StmtStep StepIf(TokenStream &p, AstNode *&result);
+  StmtStep StepFor(TokenStream &p, AstNode *&result);
+  StmtStep StepWhile(TokenStream &p, AstNode *&result);
+  StmtStep StepDoWhile(TokenStream &p, AstNode *&result);
 
   /**
-   * Expression, 9 levels of precedence
+   * @brief   The frame of an expression waiting for its rhs. The frame of
+   *          parenthesis or printf is closed by ), and its expression
+   *          becomes a operand of the frame below.
    */
-  AstNode *ParsePrimaryExpr(TokenIterator &p);
-  AstNode *ParsePostfixExpr(TokenIterator &p);
-  AstNode *ParsePosNegExpr(TokenIterator &p);
-  AstNode *ParseMulDivExpr(TokenIterator &p);
-  AstNode *ParseAddSubExpr(TokenIterator &p);
-  AstNode *ParseCompareExpr(TokenIterator &p);
-  AstNode *ParseEquationExpr(TokenIterator &p);
-  AstNode *ParseAssignExpr(TokenIterator &p);
-  AstNode *ParseCommaExpr(TokenIterator &p);
-  AstNode *ParseExpr(TokenIterator &p);
+  struct ExprFrame {
+    enum Kind { kBinary, kParen, kPrintf };
+
+    Kind kind;
+    int min_power;
+    AstNode *lhs;     // the lhs of pending binary operator
+    AstNode *op;      // the pending binary operator
+    AstNode *prefix;  // the prefix + - of the operand being parsed
+    AstNode *opener;  // the printf node
+  };
+
+  bool PushExprFrame(ExprFrame::Kind kind, int min_power, AstNode *opener);
+  bool CheckDepth();
 
   /**
-   * Control structure
+   * Incremental re-parsing of a block, @see Reparse()
    */
-  AstNode *ParseIf(TokenIterator &p);
-  AstNode *ParseFor(TokenIterator &p);
-  AstNode *ParseWhile(TokenIterator &p);
-  AstNode *ParseDoWhile(TokenIterator &p);
+  enum ReparseResult {
+    kSpliced,         // the new statements are spliced into the block
+    kRetryOuter,      // the block ends before the old statements are reused
+    kParseAll,        // the whole ast should be parsed again
+  };
+
+  ReparseResult ReparseBlock(const std::vector<Token> &tokens,
+                             AstNode *block,
+                             bool is_root,
+                             uint32_t edit_beg,
+                             uint32_t edit_end);
 
  private:
   Ast ast_;
+  std::vector<StmtFrame> stmt_stack_;
+  std::vector<ExprFrame> expr_stack_;
+  size_t max_depth_{kDefaultMaxDepth};
+  std::vector<ParseDiagnostic> diagnostics_;
+  bool is_hash_consing_{false};
+  bool is_error_{false};
+  bool is_panic_{false};
 };
@@ -438,6 +438,104 @@ shared_ptr<DFA> DFAOptimizer::Minimize() {
   return minimum;
 }
 
+
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief   a help class, union two DFAs by the product construction
+ */
+class DFAUnion {
+ private:
+  friend shared_ptr<DFA>
+  regular_expression::UnionDFA(const DFA &lhs,
+                               const DFA &rhs,
+                               const std::function<bool(int, int)> &is_higher);
+
+  typedef pair<const DFANode *, const DFANode *> NodePair;
+
+  struct NodePairHasher {
+    size_t operator()(const NodePair &p) const {
+      return std::hash<const DFANode *>()(p.first) * 31
+          + std::hash<const DFANode *>()(p.second);
+    }
+  };
+
+  DFAUnion(const DFA &lhs,
+           const DFA &rhs,
+           const std::function<bool(int, int)> &is_higher)
+      : lhs_(lhs), rhs_(rhs), is_higher_(is_higher) {}
+
+  DFANode *GetUnionNode(const NodePair &p);
+
+  shared_ptr<DFA> Union();
+
+ private:
+  const DFA &lhs_;
+  const DFA &rhs_;
+  const std::function<bool(int, int)> &is_higher_;
+
+  unordered_map<NodePair, DFANode *, NodePairHasher> pair_to_node_;
+  vector<NodePair> unvisited_;
+  vector<DFANode *> ends_;
+  vector<DFANode *> nodes_;
+};
+
+DFANode *DFAUnion::GetUnionNode(const NodePair &p) {
+  auto iter = pair_to_node_.find(p);
+  if (pair_to_node_.end() != iter) {
+    return iter->second;
+  }
+
+  auto *node = new DFANode(Node::kNormal);
+  for (const DFANode *u : {p.first, p.second}) {
+    if (!u || !u->IsEnd()) {
+      continue;
+    }
+    if (!node->IsEnd()) {
+      node->AttachState(Node::kEnd);
+      node->set_priority(u->priority());
+      ends_.push_back(node);
+    } else if (is_higher_(u->priority(), node->priority())) {
+      node->set_priority(u->priority());
+    }
+  }
+
+  pair_to_node_.emplace(p, node);
+  nodes_.push_back(node);
+  unvisited_.push_back(p);
+  return node;
+}
+
+shared_ptr<DFA> DFAUnion::Union() {
+  DFANode *start = GetUnionNode({lhs_.start(), rhs_.start()});
+  start->AttachState(Node::kStart);
+
+  // a pair with one side dead is a copy of the other side, so only the
+  // states reached by both sides together are determinized again
+  while (!unvisited_.empty()) {
+    NodePair p = unvisited_.back();
+    unvisited_.pop_back();
+    DFANode *u = pair_to_node_[p];
+
+    for (const DFANode *side : {p.first, p.second}) {
+      if (!side) {
+        continue;
+      }
+      for (auto &edge : side->edges()) {
+        char c = edge.first;
+        if (u->GetNextNode(c)) {
+          continue;
+        }
+        NodePair next{p.first ? p.first->GetNextNode(c) : nullptr,
+                      p.second ? p.second->GetNextNode(c) : nullptr};
+        u->AddEdge(c, GetUnionNode(next));
+      }
+    }
+  }
+
+  return make_shared<DFA>(start, move(ends_), move(nodes_));
+}
+
 } // end of anonymous namespace
 
 
@@ -470,6 +568,8 @@ string to_string(const NFAEdge &edge) {
  * class Node
  */
 
+constexpr int Node::kUnsetInt;
+
 void Node::AttachState(State state) {
   if ((kStart == state_ && kEnd == state)
       || (kStart == state && kEnd == state_)) {
@@ -822,4 +922,10 @@ std::shared_ptr<DFA> ConvertNFAToDFA(const NFA *nfa) {
   return DFAConverter(nfa).Convert();
 }
 
+std::shared_ptr<DFA> UnionDFA(const DFA &lhs,
+                              const DFA &rhs,
+                              const std::function<bool(int, int)> &is_higher) {
+  return DFAUnion(lhs, rhs, is_higher).Union();
+}
+
 } // end of namespace regular_expression
@@ -19,6 +19,7 @@
 #include <cassert>
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <string>
 #include <bitset>
@@ -93,6 +94,21 @@ std::shared_ptr<DFA> MinimizeDFA(const std::shared_ptr<DFA> normal);
  */
 std::shared_ptr<DFA> ConvertNFAToDFA(const NFA *nfa);
 
+/**
+ * @brief   Union two DFAs by the product construction. Only the states
+ *          reached by both DFAs together are new, the others are copied from
+ *          one side without determinizing again.
+ * @param lhs       the DFA to be extended
+ * @param rhs       the DFA to be added
+ * @param is_higher whether the first priority is higher than the second one,
+ *                  an END state reached by both DFAs takes the higher one
+ * @return          the union DFA, which is not minimized
+ */
+std::shared_ptr<DFA> UnionDFA(const DFA &lhs,
+                              const DFA &rhs,
+                              const std::function<bool(int, int)> &is_higher
+                              = std::less<int>());
+
 
 /*----------------------------------------------------------------------------*/
 
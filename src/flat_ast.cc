@@ -0,0 +1,100 @@
+//
+// Created by Dyinnz on 16-11-10.
+//
+
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include "flat_ast.h"
+
+constexpr uint32_t FlatAst::kNullIndex;
+constexpr uint32_t FlatAst::kNoOffset;
+
+FlatAst::FlatAst(const Ast &ast) : source_(ast.source()), lines_(ast.lines()) {
+  if (!ast.root()) {
+    return;
+  }
+
+  std::unordered_map<Symbol, uint16_t> symbol_to_code;
+  auto encode = [this, &symbol_to_code](const Symbol &symbol) {
+    auto iter = symbol_to_code.find(symbol);
+    if (symbol_to_code.end() == iter) {
+      auto code = static_cast<uint16_t>(symbols_.size());
+      symbols_.push_back(symbol);
+      iter = symbol_to_code.emplace(symbol, code).first;
+    }
+    return iter->second;
+  };
+
+  // the nodes are appended in breadth-first order, so the children of a node
+  // are appended together. The shared children are appended once.
+  std::unordered_map<const AstNode *const *, uint32_t> shared_children;
+  std::vector<const AstNode *> order{ast.root()};
+  for (size_t i = 0; i < order.size(); ++i) {
+    const AstNode *u = order[i];
+    FlatNode node;
+    if (!u) {
+      node.symbol = encode(kErrorSymbol);
+      storage_.push_back(node);
+      continue;
+    }
+
+    node.symbol = encode(u->symbol());
+    if (u->position()) {
+      node.offset = static_cast<uint32_t>(u->position() - source_);
+      node.length = u->length();
+      node.value = u->value();
+    }
+    auto children = u->children();
+    node.first_child = static_cast<uint32_t>(order.size());
+    node.child_num = static_cast<uint32_t>(children.size());
+    node.is_sharing = u->IsSharingChildren();
+    if (ast.IsHashConsed() && !children.empty()) {
+      auto result = shared_children.emplace(children.begin(),
+                                            node.first_child);
+      if (!result.second) {
+        node.first_child = result.first->second;
+        storage_.push_back(node);
+        continue;
+      }
+    }
+    storage_.push_back(node);
+
+    for (auto child : children) {
+      order.push_back(child);
+    }
+  }
+
+  nodes_ = storage_.data();
+  size_ = static_cast<uint32_t>(storage_.size());
+}
+
+std::string FlatAst::text(uint32_t index) const {
+  const FlatNode &node = nodes_[index];
+  return kNoOffset != node.offset
+         ? std::string(source_ + node.offset, node.length)
+         : std::string();
+}
+
+std::string FlatAst::to_string(uint32_t index) const {
+  std::ostringstream oss;
+  if (symbol(index).IsTerminal()) {
+    oss << "Node/T { " << symbol(index) << ", " << text(index) << "}";
+  } else {
+    oss << "Node/NT { " << symbol(index) << " }";
+  }
+  return oss.str();
+}
+
+/**
+ * @see flat_ast.h
+ */
+void PrintFlatAst(const FlatAst &ast, uint32_t index) {
+  ast.Walk(index, [&ast](uint32_t u, int depth) {
+    for (int i = 0; i < depth; ++i) {
+      std::cout << "    ";
+    }
+    std::cout << ast.to_string(u) << std::endl;
+    return true;
+  });
+}
@@ -0,0 +1,294 @@
+//
+// Created by Dyinnz on 16-11-10.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+class MappedFile;
+
+/**
+ * @brief   The node of flat ast, addressed by 32-bit index.
+ *
+ * @details The children of a node are stored contiguously in the node array,
+ *          from first_child to first_child + child_num. The symbol is encoded
+ *          as a code by the dictionary of FlatAst.
+ */
+struct FlatNode {
+  uint32_t first_child{0};
+  uint32_t child_num{0};
+  /**
+   * @brief   the offset of token attached in source text, kNoOffset if the
+   *          node is not attached to a token
+   */
+  uint32_t offset{UINT32_MAX};
+  uint32_t length{0};
+  uint32_t value{0};
+  uint16_t symbol{0};
+  /**
+   * @brief   1 if the children are shared with another node by hash-consing,
+   *          so that the rows of them are the row of this node in fact
+   */
+  uint16_t is_sharing{0};
+};
+
+/**
+ * @brief   The range of indices of the children
+ */
+class FlatChildren {
+ public:
+  class const_iterator {
+   public:
+    explicit const_iterator(uint32_t index) : index_(index) {}
+
+    uint32_t operator*() const {
+      return index_;
+    }
+
+    const_iterator &operator++() {
+      index_ += 1;
+      return *this;
+    }
+
+    const_iterator operator+(uint32_t n) const {
+      return const_iterator(index_ + n);
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return index_ == rhs.index_;
+    }
+
+    bool operator!=(const const_iterator &rhs) const {
+      return index_ != rhs.index_;
+    }
+
+   private:
+    uint32_t index_;
+  };
+
+  FlatChildren(uint32_t first, uint32_t size) : first_(first), size_(size) {}
+
+  const_iterator begin() const {
+    return const_iterator(first_);
+  }
+
+  const_iterator end() const {
+    return const_iterator(first_ + size_);
+  }
+
+  uint32_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return 0 == size_;
+  }
+
+  uint32_t operator[](uint32_t i) const {
+    return first_ + i;
+  }
+
+  uint32_t front() const {
+    return first_;
+  }
+
+  uint32_t back() const {
+    return first_ + size_ - 1;
+  }
+
+ private:
+  uint32_t first_;
+  uint32_t size_;
+};
+
+/**
+ * @brief   A compact Abstract Syntax Tree stored in a single array.
+ *
+ * @details The nodes are laid out in breadth-first order, so that the
+ *          children of each node are contiguous, and a tree walk touches
+ *          contiguous memory instead of chasing pointers. A null child in
+ *          the pointer-based ast, left by a syntax error, is converted to a
+ *          node of kErrorSymbol.
+ *
+ *          The children shared by the nodes of a hash-consed Ast are
+ *          stored once. @see Ast::HashConsExprs()
+ *
+ *          The text of nodes refers to the source text, which is not owned
+ *          by the tree. The nodes are either converted from a Ast, or mapped
+ *          from a cache file by AstCache.
+ */
+class FlatAst {
+ public:
+  static constexpr uint32_t kNullIndex = UINT32_MAX;
+  static constexpr uint32_t kNoOffset = UINT32_MAX;
+
+  FlatAst() = default;
+
+  FlatAst(const FlatAst &) = delete;
+  FlatAst &operator=(const FlatAst &) = delete;
+
+  FlatAst(FlatAst &&) = default;
+  FlatAst &operator=(FlatAst &&) = default;
+
+  /**
+   * @brief     Convert from the pointer-based ast, which could be released
+   *            after converting
+   * @param ast     The ast with source text set
+   */
+  explicit FlatAst(const Ast &ast);
+
+  /**
+   * @return    The index of root, or kNullIndex if the tree is empty
+   */
+  uint32_t root() const {
+    return 0 == size_ ? kNullIndex : 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  const FlatNode &node(uint32_t index) const {
+    return nodes_[index];
+  }
+
+  const Symbol &symbol(uint32_t index) const {
+    return symbols_[nodes_[index].symbol];
+  }
+
+  FlatChildren children(uint32_t index) const {
+    return FlatChildren(nodes_[index].first_child, nodes_[index].child_num);
+  }
+
+  uint32_t child_num(uint32_t index) const {
+    return nodes_[index].child_num;
+  }
+
+  /**
+   * @return    The index of the n-th child
+   */
+  uint32_t child(uint32_t index, uint32_t n) const {
+    return nodes_[index].first_child + n;
+  }
+
+  /**
+   * @return    Whether there is no node of kErrorSymbol, which is left by a
+   *            syntax error
+   */
+  bool IsComplete() const {
+    return std::find(symbols_.begin(), symbols_.end(), kErrorSymbol)
+        == symbols_.end();
+  }
+
+  /**
+   * @return    Whether the children are shared with another node
+   */
+  bool IsSharing(uint32_t index) const {
+    return 0 != nodes_[index].is_sharing;
+  }
+
+  /**
+   * @return    The ID of the interned lexeme, such as the identifier
+   */
+  uint32_t value(uint32_t index) const {
+    return nodes_[index].value;
+  }
+
+  /**
+   * @return    The value of the decoded integer literal
+   */
+  int32_t number(uint32_t index) const {
+    return static_cast<int32_t>(nodes_[index].value);
+  }
+
+  /**
+   * @return    The string extracted from source code if the node attached to
+   *            a token, or empty
+   */
+  std::string text(uint32_t index) const;
+
+  /**
+   * @return    The row of the token attached to the node, or SIZE_MAX
+   */
+  size_t row(uint32_t index) const {
+    uint32_t offset = nodes_[index].offset;
+    return kNoOffset != offset ? lines_.Row(offset) : SIZE_MAX;
+  }
+
+  /**
+   * @return    The column of the token attached to the node, or SIZE_MAX
+   */
+  size_t column(uint32_t index) const {
+    uint32_t offset = nodes_[index].offset;
+    return kNoOffset != offset ? lines_.Column(offset) : SIZE_MAX;
+  }
+
+  const char *source() const {
+    return source_;
+  }
+
+  const LineIndex &lines() const {
+    return lines_;
+  }
+
+  /**
+   * @brief     Auxiliary function for debuging & printing
+   * @return    A string representing the node
+   */
+  std::string to_string(uint32_t index) const;
+
+  /**
+   * @brief     Visit the nodes of a sub tree in pre-order, without recursion
+   * @param index   The root of sub tree
+   * @param visitor Called as visitor(index, depth), returns whether to visit
+   *                the children of the node
+   */
+  template<class Visitor>
+  void Walk(uint32_t index, Visitor &&visitor) const;
+
+ private:
+  friend class AstCache;
+
+  const FlatNode *nodes_{nullptr};
+  uint32_t size_{0};
+  // the nodes converted from Ast
+  std::vector<FlatNode> storage_;
+  // the nodes mapped from a cache file
+  std::shared_ptr<const MappedFile> mapping_;
+
+  std::vector<Symbol> symbols_;
+  const char *source_{nullptr};
+  LineIndex lines_;
+};
+
+template<class Visitor>
+void FlatAst::Walk(uint32_t index, Visitor &&visitor) const {
+  std::vector<std::pair<uint32_t, int>> stack{{index, 0}};
+  while (!stack.empty()) {
+    uint32_t u = stack.back().first;
+    int depth = stack.back().second;
+    stack.pop_back();
+    if (kNullIndex == u || !visitor(u, depth)) {
+      continue;
+    }
+
+    // push reversely, so that the first child is visited first
+    const FlatNode &node = nodes_[u];
+    for (uint32_t i = node.child_num; i > 0; --i) {
+      stack.emplace_back(node.first_child + i - 1, depth + 1);
+    }
+  }
+}
+
+/**
+ * @brief   Auxililary function that prints flat ast by walking it
+ * @param ast   The flat ast
+ * @param index The root of a (sub) ast
+ */
+void PrintFlatAst(const FlatAst &ast, uint32_t index);
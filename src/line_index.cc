@@ -0,0 +1,25 @@
+//
+// Created by Dyinnz on 16-11-05.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "line_index.h"
+
+LineIndex::LineIndex(const char *beg, const char *end) {
+  // memchr is vectorized by libc
+  const char *p = beg;
+  while (p < end) {
+    p = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (!p) {
+      break;
+    }
+    p += 1;
+    line_starts_.push_back(static_cast<uint32_t>(p - beg));
+  }
+}
+
+size_t LineIndex::Row(uint32_t offset) const {
+  return std::upper_bound(line_starts_.begin(), line_starts_.end(), offset)
+      - line_starts_.begin();
+}
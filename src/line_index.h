@@ -0,0 +1,78 @@
+//
+// Created by Dyinnz on 16-11-05.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief   The offsets where the lines of a source text start.
+ *
+ * @details Tokens and nodes only record the byte offsets of lexemes, the row
+ *          and column are resolved by binary search on request. A row starts
+ *          after each LF in the source text. The row is 1-based, and the
+ *          column is 0-based.
+ */
+class LineIndex {
+ public:
+  /**
+   * @brief     An index of a text with only one line
+   */
+  LineIndex() = default;
+
+  /**
+   * @param beg the begin position of source text
+   * @param end the end position of source text
+   */
+  LineIndex(const char *beg, const char *end);
+
+  /**
+   * @param line_starts the offsets where the lines start, from 0 ascendingly
+   */
+  explicit LineIndex(std::vector<uint32_t> line_starts)
+      : line_starts_(std::move(line_starts)) {}
+
+  /**
+   * @return    The row of the byte at offset
+   */
+  size_t Row(uint32_t offset) const;
+
+  /**
+   * @return    The column of the byte at offset
+   */
+  size_t Column(uint32_t offset) const {
+    return offset - LineStart(Row(offset));
+  }
+
+  /**
+   * @return    The offset of the first byte of the row
+   */
+  uint32_t LineStart(size_t row) const {
+    return line_starts_[row - 1];
+  }
+
+  /**
+   * @return    The offset where the next row starts, or UINT32_MAX for the
+   *            last row
+   */
+  uint32_t LineEnd(size_t row) const {
+    return row < line_starts_.size() ? line_starts_[row] : UINT32_MAX;
+  }
+
+  /**
+   * @return    The number of rows
+   */
+  size_t size() const {
+    return line_starts_.size();
+  }
+
+  const std::vector<uint32_t> &line_starts() const {
+    return line_starts_;
+  }
+
+ private:
+  std::vector<uint32_t> line_starts_{0};
+};
@@ -1,77 +1,78 @@
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <cstring>
-
+#include "mapped_file.h"
 #include "simplelogger.h"
 #include "clike_grammar.h"
 #include "clike_parser.h"
 #include "clike_interpreter.h"
+#include "ast_cache.h"
 
 using namespace std;
 using namespace simple_logger;
 
 BaseLogger logger;
 
-static std::streampos GetFileLength(ifstream &fin) {
-  auto backup = fin.tellg();
-  fin.seekg(0, fin.end);
-  auto length = fin.tellg();
-  fin.seekg(backup, fin.beg);
-  return length;
-}
-
-char *ReadFileData(const string &path, size_t &size) {
-  ifstream fin(path);
-  if (!fin) {
-    return nullptr;
-  }
-
-  size = static_cast<size_t>(GetFileLength(fin));
-  auto data = new char[size + 1];
-  memset(data, 0, sizeof(char) * (size + 1));
-
-  if (fin.read(data, size)) {
-    return data;
-
-  } else {
-    delete data;
-    return nullptr;
-  }
-}
-
-#define GET_FILE_DATA_SAFELY(name, size, relative_path) \
-size_t size = 0; \
-const char *name = ReadFileData((relative_path), (size)); \
-ScopeGuard [&] { delete[] name; };
-
 static const char *kInputFilename = "input.txt";
 static const char *kOutputFilename = "output.txt";
 
 int main() {
-  GET_FILE_DATA_SAFELY(data, size, kInputFilename);
+  // the data is mapped from file, and NOT terminated by '\0'
+  MappedFile input(kInputFilename);
+  const char *data = input.data();
+  size_t size = input.size();
   logger.set_log_level(kError);
 
-  logger.debug("\n{}", data);
-
-  // split source string to tokens
-  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
-  vector<Token> tokens;
-  auto result = tokenizer.LexicalAnalyze(data, data + size, tokens);
-  if (!result) {
-    return -1;
+  // the input is only copied to a string when it is printed
+  if (kDebug >= logger.log_level()) {
+    logger.debug("\n{}", string(data ? data : "", size));
   }
 
-  for (auto &t : tokens) {
-    logger.debug("{}", to_string(t));
+  // the directory of parsed trees cache, disabled if not set
+  const char *cache_dir = getenv("SEEDCUP_AST_CACHE");
+  StringInterner interner;
+  FlatAst flat_ast;
+  bool is_cached = false;
+  if (cache_dir && data) {
+    AstCache cache(cache_dir, clike_grammar::ClikeSymbols());
+    is_cached = cache.Load(data, size, flat_ast, &interner);
   }
 
-  // syntax analysis
-  ClikeParser parser;
-  auto ast = parser.Parse(tokens);
+  if (!is_cached) {
+    // split source string to tokens lazily, while parsing
+    auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+    TokenStream stream(tokenizer, data, data + size, &interner);
+
+    // syntax analysis, the repeated expressions share the nodes if
+    // hash-consing is enabled
+    ClikeParser parser;
+    parser.set_hash_consing(nullptr != getenv("SEEDCUP_HASH_CONS"));
+    auto ast = parser.Parse(stream);
+    if (stream.IsError() || parser.IsError()) {
+      return -1;
+    }
+
+    // all the syntax errors are reported, and the broken program is neither
+    // cached nor run
+    if (!parser.diagnostics().empty() || !ast.IsComplete()) {
+      for (auto &diagnostic : parser.diagnostics()) {
+        cerr << kInputFilename << ":" << diagnostic.row << ":"
+             << diagnostic.column + 1 << ": " << diagnostic.message << endl;
+      }
+      return -1;
+    }
+
+    flat_ast = FlatAst(ast);
+    if (cache_dir) {
+      AstCache cache(cache_dir, clike_grammar::ClikeSymbols());
+      cache.Save(data, size, flat_ast, &interner);
+    }
+  }
 
   // interpret ast
-  ClikeInterpreter interpreter(std::move(ast));
-  interpreter.Exec();
+  ClikeInterpreter interpreter(std::move(flat_ast));
+  if (!interpreter.Exec()) {
+    return -1;
+  }
   interpreter.OutputLines(kOutputFilename);
 
   return 0;
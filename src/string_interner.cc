@@ -0,0 +1,67 @@
+//
+// Created by Dyinnz on 16-11-06.
+//
+
+#include <cstring>
+#include "string_interner.h"
+
+constexpr size_t StringInterner::kInitSlots;
+constexpr uint32_t StringInterner::kEmptySlot;
+
+StringInterner::StringInterner()
+    : offsets_(1, 0), slots_(kInitSlots, kEmptySlot) {
+}
+
+uint32_t StringInterner::Hash(const char *s, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(s[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool StringInterner::IsEqual(uint32_t id, const char *s, size_t len) const {
+  return offsets_[id + 1] - offsets_[id] == len
+      && 0 == memcmp(pool_.data() + offsets_[id], s, len);
+}
+
+uint32_t StringInterner::Intern(const char *s, size_t len) {
+  uint32_t hash = Hash(s, len);
+  size_t mask = slots_.size() - 1;
+
+  size_t i = hash & mask;
+  while (kEmptySlot != slots_[i]) {
+    uint32_t id = slots_[i];
+    if (hashes_[id] == hash && IsEqual(id, s, len)) {
+      return id;
+    }
+    i = (i + 1) & mask;
+  }
+
+  // first seen
+  auto id = static_cast<uint32_t>(hashes_.size());
+  pool_.append(s, len);
+  offsets_.push_back(static_cast<uint32_t>(pool_.size()));
+  hashes_.push_back(hash);
+  slots_[i] = id;
+
+  // keep the load factor under 1/2
+  if (hashes_.size() * 2 > slots_.size()) {
+    Grow();
+  }
+  return id;
+}
+
+void StringInterner::Grow() {
+  slots_.assign(slots_.size() * 2, kEmptySlot);
+  size_t mask = slots_.size() - 1;
+
+  for (uint32_t id = 0; id < hashes_.size(); ++id) {
+    size_t i = hashes_[id] & mask;
+    while (kEmptySlot != slots_[i]) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = id;
+  }
+}
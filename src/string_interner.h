@@ -0,0 +1,70 @@
+//
+// Created by Dyinnz on 16-11-06.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief   Map each distinct string to a dense 32-bit ID.
+ *
+ * @details The IDs are assigned from 0 in the order that the strings are
+ *          first seen, so they could be used to index arrays. The strings are
+ *          copied into a pool, and looked up in an open addressing hash table
+ *          with FNV-1a hash and linear probing.
+ *
+ *          The interner is not thread-safe.
+ */
+class StringInterner {
+ public:
+  StringInterner();
+
+  /**
+   * @param s   the begin of string
+   * @param len the length of string
+   * @return    the ID of string, a new ID if it is first seen
+   */
+  uint32_t Intern(const char *s, size_t len);
+
+  uint32_t Intern(const std::string &s) {
+    return Intern(s.c_str(), s.size());
+  }
+
+  /**
+   * @return    the string of ID
+   */
+  std::string str(uint32_t id) const {
+    return pool_.substr(offsets_[id], offsets_[id + 1] - offsets_[id]);
+  }
+
+  /**
+   * @return    the number of distinct strings
+   */
+  size_t size() const {
+    return hashes_.size();
+  }
+
+ private:
+  static uint32_t Hash(const char *s, size_t len);
+
+  bool IsEqual(uint32_t id, const char *s, size_t len) const;
+
+  /**
+   * @brief     Double the slots and rehash all the IDs
+   */
+  void Grow();
+
+ private:
+  static constexpr size_t kInitSlots = 64;
+  static constexpr uint32_t kEmptySlot = UINT32_MAX;
+
+  std::string pool_;
+  // the string of ID i is pool_[offsets_[i], offsets_[i + 1])
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> hashes_;
+  // the size is power of 2, each slot holds an ID
+  std::vector<uint32_t> slots_;
+};
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <cassert>
 #include <climits>
+#include <cstdint>
+#include <cstring>
 #include <ostream>
 
 /**
@@ -16,6 +19,31 @@ constexpr int kEofID = kStartID - 2;
 constexpr int kEpsilonID = kStartID - 3;
 constexpr int kSpaceID = kStartID - 4;
 constexpr int kLFID = kStartID - 5;
+constexpr int kLineCommentID = kStartID - 6;
+constexpr int kBlockCommentID = kStartID - 7;
+
+/**
+ * @brief   The number of dense indices of symbols, @see SymbolIndex()
+ */
+constexpr int kSymbolIndexNum = 256;
+constexpr int kCharSymbolNum = 128;
+
+/**
+ * @brief   Map the ID of symbol to a dense index in [0, kSymbolIndexNum), so
+ *          that a table indexed by symbols is a small array, and a switch on
+ *          the index is compiled to a jump table. The char symbols take their
+ *          ASCII, then the predefined symbols and the ones declared by
+ *          DECLARE_SYMBOL() follow. Any other ID is mapped to 0, which is not
+ *          a symbol.
+ */
+constexpr int SymbolIndex(int id) {
+  return id > 0 && id < kCharSymbolNum
+         ? id
+         : id >= kBlockCommentID
+             && id - kBlockCommentID < kSymbolIndexNum - kCharSymbolNum
+           ? kCharSymbolNum + (id - kBlockCommentID)
+           : 0;
+}
 
 /**
  * Some marcos that declare & define symbol. Define symbol ID and string
@@ -38,7 +66,17 @@ const char *_##name() { return __func__; }\
 const Symbol name(Symbol::kNonTerminal, name##ID, _##name() + 2);
 
 /**
- * @brief   Generalized grammar symbol.
+ * @brief   Generalized grammar symbol. It is packed in 4 bytes, so that a
+ *          token or an AST node holding it stays small. The string
+ *          representation is registered by the constructor in a table
+ *          indexed by the type and SymbolIndex(), and resolved on request.
+ *
+ *          So the symbols of one program should have distinct dense
+ *          indices, which is asserted on registering. The grammars with
+ *          overlapping IDs, e.g. the clike symbols and the ones of tests,
+ *          could not be linked together. The symbols should be defined at
+ *          namespace scope, so that the table is filled before main() and
+ *          read without locking.
  */
 class Symbol {
  public:
@@ -50,10 +88,13 @@ class Symbol {
    * @param id      A unique number
    * @param str     A string representation
    */
-  Symbol(Type type, int id, const char *str)
-      : type_(type), id_(id), str_(str) {}
+  Symbol(Type type, int id, const char *str) : id_(id), type_(type) {
+    const char *&name = Names()[type_][Index()];
+    assert(!name || 0 == strcmp(name, str));
+    name = str;
+  }
 
-  Symbol() : type_(kTerminal), id_(kErrorID) {}
+  Symbol() : id_(kErrorID), type_(kTerminal) {}
 
   bool IsTerminal() const {
     return type_ == kTerminal;
@@ -64,15 +105,27 @@ class Symbol {
   }
 
   Type type() const {
-    return type_;
+    return static_cast<Type>(type_);
   }
 
   int ID() const {
     return id_;
   }
 
+  /**
+   * @return    The dense index of symbol, @see SymbolIndex()
+   */
+  int Index() const {
+    return SymbolIndex(id_);
+  }
+
+  /**
+   * @return    The string representation given by the constructor, it is
+   *            looked up so it should only be used for printing
+   */
   const char *str() const {
-    return str_;
+    const char *name = Names()[type_][Index()];
+    return name ? name : "nullptr";
   }
 
   /**
@@ -91,11 +144,22 @@ class Symbol {
   }
 
  private:
-  Type type_;
-  int id_;
-  const char *str_{"nullptr"};
+  /**
+   * @brief   The names indexed by type and dense index, it is constant
+   *          initialized, so it is ready before any symbol is defined
+   */
+  using NameTable = const char *[2][kSymbolIndexNum];
+  static NameTable &Names() {
+    static NameTable names{};
+    return names;
+  }
+
+  int id_ : 31;
+  unsigned type_ : 1;
 };
 
+static_assert(4 == sizeof(Symbol), "a symbol is packed in 4 bytes");
+
 namespace std {
 
 /**
@@ -112,6 +176,52 @@ struct hash<Symbol> {
 } // end of namespace std
 
 
+/**
+ * @brief   A set of symbols stored as a bitset indexed by SymbolIndex(), so
+ *          that the lookup is O(1) without hashing. It is built from the IDs
+ *          at compile time, e.g. constexpr SymbolSet s(kAddID, kSubID);
+ */
+class SymbolSet {
+ public:
+  template<class... A>
+  constexpr explicit SymbolSet(A... ids)
+      : words_{WordOf(0, ids...), WordOf(1, ids...),
+               WordOf(2, ids...), WordOf(3, ids...)} {}
+
+  constexpr bool Contains(int id) const {
+    return 0 != (words_[SymbolIndex(id) / 64] >> (SymbolIndex(id) % 64) & 1);
+  }
+
+  bool Contains(const Symbol &symbol) const {
+    return Contains(symbol.ID());
+  }
+
+  constexpr SymbolSet operator|(const SymbolSet &rhs) const {
+    return SymbolSet(Words(),
+                     words_[0] | rhs.words_[0], words_[1] | rhs.words_[1],
+                     words_[2] | rhs.words_[2], words_[3] | rhs.words_[3]);
+  }
+
+ private:
+  struct Words {};
+
+  constexpr SymbolSet(Words, uint64_t w0, uint64_t w1, uint64_t w2, uint64_t w3)
+      : words_{w0, w1, w2, w3} {}
+
+  static constexpr uint64_t WordOf(int) {
+    return 0;
+  }
+
+  template<class... A>
+  static constexpr uint64_t WordOf(int word, int id, A... ids) {
+    return (SymbolIndex(id) / 64 == word ? 1ull << (SymbolIndex(id) % 64) : 0)
+        | WordOf(word, ids...);
+  }
+
+  static_assert(4 * 64 == kSymbolIndexNum, "the bitset is 4 words");
+  uint64_t words_[4];
+};
+
 /**
  * Predefined symbol
  */
@@ -121,6 +231,12 @@ static const Symbol kEofSymbol(Symbol::kTerminal, kEofID, "EOF");
 static const Symbol kEpsilonSymbol(Symbol::kTerminal, kEpsilonID, "Epsilon");
 static const Symbol kSpaceSymbol(Symbol::kTerminal, kSpaceID, "Space");
 static const Symbol kLFSymbol(Symbol::kTerminal, kLFID, "LF");
+static const Symbol kLineCommentSymbol(Symbol::kTerminal,
+                                       kLineCommentID,
+                                       "LineComment");
+static const Symbol kBlockCommentSymbol(Symbol::kTerminal,
+                                        kBlockCommentID,
+                                        "BlockComment");
 
 /**
  * @brief Override the left-shift operator for easier printing
@@ -4,44 +4,79 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include "symbol.h"
 
 /**
- * @brief   A token contains text extracted from source text, row and column
- *          number in source text.
+ * @brief   A token is a view of a lexeme in the source text. It only records
+ *          the offset and length of the lexeme, the text could be
+ *          materialized from the source text on request. The row and column
+ *          could be resolved from the offset by LineIndex. With the packed
+ *          symbol, a token is 16 bytes.
  */
 struct Token {
-  Token(std::string text, const Symbol &symbol)
-      : text(std::move(text)), symbol(symbol) {}
+  Token(const Symbol &symbol, uint32_t offset = 0, uint32_t length = 0)
+      : symbol(symbol), offset(offset), length(length) {}
 
   bool operator==(const Token &rhs) const {
-    return text == rhs.text && symbol == rhs.symbol;
+    return symbol == rhs.symbol && offset == rhs.offset
+        && length == rhs.length;
   }
 
   bool operator!=(const Token &rhs) const {
     return !operator==(rhs);
   }
 
-  std::string text;
+  /**
+   * @param source  the source text which the token extracted from
+   * @return        the text of the lexeme
+   */
+  std::string text(const char *source) const {
+    return std::string(source + offset, length);
+  }
+
   Symbol symbol;
-  size_t row{0};
-  size_t column{0};
+  uint32_t offset{0};
+  uint32_t length{0};
+  /**
+   * @brief     the ID of lexeme if it is interned by StringInterner, or the
+   *            bits of int32_t value if it is a decoded integer literal
+   */
+  uint32_t value{0};
 };
 
+static_assert(16 == sizeof(Token), "a token is 16 bytes");
+
 /**
  * Predefine token which will be used frequently
  */
-static const Token kErrorToken("kErrorToken", kErrorSymbol);
-static const Token kEofToken("kEofToken", kEofSymbol);
+static const Token kErrorToken(kErrorSymbol);
+static const Token kEofToken(kEofSymbol);
+
+/**
+ * @brief   The value of a lexeme which should be interned, but is lexed
+ *          without an interner. It could not be used as an ID.
+ */
+constexpr uint32_t kNotInterned = UINT32_MAX;
 
 /**
  * @brief   A helper function for debugging
  */
 inline std::string to_string(const Token &token) {
   std::ostringstream oss;
-  oss << "Token { P(" << token.row << ',' << token.column << "), "
-      << token.symbol << ", " << token.text << " }";
+  oss << "Token { " << token.symbol << ", [" << token.offset << ", +"
+      << token.length << "] }";
+  return oss.str();
+}
+
+/**
+ * @brief   A helper function for debugging, with the text of lexeme
+ */
+inline std::string to_string(const Token &token, const char *source) {
+  std::ostringstream oss;
+  oss << "Token { " << token.offset << ", " << token.symbol << ", "
+      << token.text(source) << " }";
   return oss.str();
 }
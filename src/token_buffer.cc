@@ -0,0 +1,28 @@
+//
+// Created by Dyinnz on 16-11-07.
+//
+
+#include "token_buffer.h"
+
+void TokenBuffer::push_back(const Token &token) {
+  codes_.push_back(Encode(token.symbol));
+  offsets_.push_back(token.offset);
+  lengths_.push_back(token.length);
+  values_.push_back(token.value);
+}
+
+uint16_t TokenBuffer::Encode(const Symbol &symbol) {
+  // the symbol IDs are small and non-negative
+  assert(0 <= symbol.ID() && symbol.ID() <= UINT16_MAX);
+  auto id = static_cast<size_t>(symbol.ID());
+  if (id >= code_of_id_.size()) {
+    code_of_id_.resize(id + 1, 0);
+  }
+
+  if (0 == code_of_id_[id]) {
+    assert(dict_.size() < UINT16_MAX);
+    dict_.push_back(symbol);
+    code_of_id_[id] = static_cast<uint16_t>(dict_.size());
+  }
+  return code_of_id_[id] - 1;
+}
@@ -0,0 +1,97 @@
+//
+// Created by Dyinnz on 16-11-07.
+//
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "token.h"
+
+/**
+ * @brief   A structure-of-arrays buffer of tokens.
+ *
+ * @details The symbols, offsets, lengths and values of tokens are stored in
+ *          separate arrays. The symbols are encoded as dense 16-bit codes by
+ *          a dictionary, so that the lookahead only touches the small code
+ *          array. A Token could be reconstructed on request.
+ */
+class TokenBuffer {
+ public:
+  /**
+   * @brief     Append a token, its symbol is encoded
+   */
+  void push_back(const Token &token);
+
+  void clear() {
+    codes_.clear();
+    offsets_.clear();
+    lengths_.clear();
+    values_.clear();
+  }
+
+  size_t size() const {
+    return codes_.size();
+  }
+
+  bool empty() const {
+    return codes_.empty();
+  }
+
+  /**
+   * @return    The i-th token reconstructed from the arrays
+   */
+  Token operator[](size_t i) const {
+    Token token(dict_[codes_[i]], offsets_[i], lengths_[i]);
+    token.value = values_[i];
+    return token;
+  }
+
+  /**
+   * @return    The code of the i-th symbol
+   */
+  uint16_t code(size_t i) const {
+    return codes_[i];
+  }
+
+  /**
+   * @return    The symbol of code
+   */
+  const Symbol &symbol_of(uint16_t code) const {
+    return dict_[code];
+  }
+
+  const Symbol &symbol(size_t i) const {
+    return dict_[codes_[i]];
+  }
+
+  uint32_t offset(size_t i) const {
+    return offsets_[i];
+  }
+
+  uint32_t length(size_t i) const {
+    return lengths_[i];
+  }
+
+  uint32_t value(size_t i) const {
+    return values_[i];
+  }
+
+ private:
+  /**
+   * @return    The code of symbol, a new one if it is first seen
+   */
+  uint16_t Encode(const Symbol &symbol);
+
+ private:
+  std::vector<uint16_t> codes_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> lengths_;
+  std::vector<uint32_t> values_;
+
+  // code -> symbol
+  std::vector<Symbol> dict_;
+  // symbol ID -> code + 1, 0 means not encoded yet
+  std::vector<uint16_t> code_of_id_;
+};
@@ -0,0 +1,94 @@
+//
+// Created by Dyinnz on 16-11-02.
+//
+
+#include <algorithm>
+#include "token_stream.h"
+
+constexpr size_t TokenStream::kMaxLookahead;
+
+TokenStream::TokenStream(const Tokenizer &tokenizer,
+                         const char *beg,
+                         const char *end,
+                         StringInterner *interner)
+    : tokenizer_(&tokenizer),
+      source_(beg),
+      source_end_(end),
+      ring_(kMaxLookahead, kEofToken) {
+  if (!tokenizer_->Reset(context_, beg, end, interner)) {
+    is_eof_ = true;
+    is_error_ = true;
+  }
+}
+
+TokenStream::TokenStream(const std::vector<Token> &tokens,
+                         const char *source,
+                         size_t first,
+                         size_t last)
+    : tokens_(&tokens),
+      tokens_pos_(first),
+      tokens_last_(std::min(last, tokens.size())),
+      source_(source),
+      source_end_(source),
+      ring_(kMaxLookahead, kEofToken) {
+  if (!tokens.empty()) {
+    source_end_ = source + tokens.back().offset + tokens.back().length;
+  }
+  // the syntax errors at the end are reported after the last token
+  eof_token_.offset = static_cast<uint32_t>(source_end_ - source_);
+}
+
+TokenStream::TokenStream(const TokenBuffer &tokens, const char *source)
+    : buffer_(&tokens),
+      source_(source),
+      source_end_(source),
+      ring_(kMaxLookahead, kEofToken) {
+  if (!tokens.empty()) {
+    size_t last = tokens.size() - 1;
+    source_end_ = source + tokens.offset(last) + tokens.length(last);
+  }
+  eof_token_.offset = static_cast<uint32_t>(source_end_ - source_);
+}
+
+void TokenStream::Fill(size_t n) {
+  while (count_ < n) {
+    ring_[(head_ + count_) % kMaxLookahead] = Pull();
+    count_ += 1;
+  }
+}
+
+Token TokenStream::Pull() {
+  if (is_eof_) {
+    return eof_token_;
+  }
+
+  if (tokens_) {
+    if (tokens_pos_ < tokens_last_
+        && kEofSymbol != (*tokens_)[tokens_pos_].symbol) {
+      return (*tokens_)[tokens_pos_++];
+    }
+    // a slice ends where the token after it begins
+    if (tokens_pos_ < tokens_->size()) {
+      eof_token_.offset = (*tokens_)[tokens_pos_].offset;
+    }
+
+  } else if (buffer_) {
+    if (tokens_pos_ < buffer_->size()
+        && kEofSymbol != buffer_->symbol(tokens_pos_)) {
+      return (*buffer_)[tokens_pos_++];
+    }
+
+  } else {
+    Token token = kEofToken;
+    if (!tokenizer_->NextToken(context_, token)) {
+      is_error_ = true;
+    } else if (kEofSymbol != token.symbol) {
+      return token;
+    } else {
+      eof_token_ = token;
+    }
+  }
+
+  is_eof_ = true;
+  return eof_token_;
+}
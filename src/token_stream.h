@@ -0,0 +1,157 @@
+//
+// Created by Dyinnz on 16-11-02.
+//
+
+#pragma once
+
+#include <vector>
+#include "tokenizer.h"
+
+/**
+ * @brief   A pull-based stream of tokens, consumed by the parser.
+ *
+ * @details The stream could pull tokens lazily from a tokenizer, so that the
+ *          lexing and parsing run as one pipelined pass, and only a small
+ *          lookahead ring buffer is kept instead of all the tokens. It could
+ *          also read from the tokens which have been extracted, stored in
+ *          a vector or a TokenBuffer.
+ *
+ *          When the source text is exhausted, or a lexical error occurs, the
+ *          stream keeps producing kEofToken as a sentry, whose offset is
+ *          the end of the source text, or of the last token read. Call
+ *          IsError() to check whether the lexing failed.
+ */
+class TokenStream {
+ public:
+  /**
+   * @brief   The max number of lookahead tokens
+   */
+  static constexpr size_t kMaxLookahead = 4;
+
+  /**
+   * @brief   Lazily pull tokens from the tokenizer
+   * @param tokenizer   The tokenizer, should outlive the stream
+   * @param beg         The begin position of source text
+   * @param end         The end position of source text
+   * @param interner    The interner of lexemes, could be nullptr
+   */
+  TokenStream(const Tokenizer &tokenizer,
+              const char *beg,
+              const char *end,
+              StringInterner *interner = nullptr);
+
+  /**
+   * @brief   Read from the extracted tokens
+   * @param tokens      The tokens, should outlive the stream
+   * @param source      The source text which the tokens extracted from,
+   *                    its end is regarded as the end of the last token
+   * @param first       The index of the token to start from
+   * @param last        The index of the token to stop at, which is read as
+   *                    kEofToken, so that a slice of tokens is read
+   */
+  TokenStream(const std::vector<Token> &tokens,
+              const char *source,
+              size_t first = 0,
+              size_t last = SIZE_MAX);
+
+  /**
+   * @brief   Read from the token buffer
+   * @param tokens      The token buffer, should outlive the stream
+   * @param source      The source text which the tokens extracted from,
+   *                    its end is regarded as the end of the last token
+   */
+  TokenStream(const TokenBuffer &tokens, const char *source);
+
+  TokenStream(const TokenStream &) = delete;
+  TokenStream &operator=(const TokenStream &) = delete;
+
+  /**
+   * @param n   The distance from the current token, should be less than
+   *            kMaxLookahead
+   * @return    The n-th token following current position, the current token
+   *            if n is 0
+   */
+  const Token &Peek(size_t n = 0) {
+    assert(n < kMaxLookahead);
+    if (n >= count_) {
+      Fill(n + 1);
+    }
+    return ring_[(head_ + n) % kMaxLookahead];
+  }
+
+  /**
+   * @return    The current token, and move to the next one
+   */
+  Token Next() {
+    Token token = Peek();
+    head_ = (head_ + 1) % kMaxLookahead;
+    count_ -= 1;
+    return token;
+  }
+
+  /**
+   * Iterator-style interface for the parser
+   */
+  const Token &operator*() {
+    return Peek();
+  }
+
+  const Token *operator->() {
+    return &Peek();
+  }
+
+  TokenStream &operator++() {
+    Next();
+    return *this;
+  }
+
+  /**
+   * @return    The source text which the tokens are extracted from
+   */
+  const char *source() const {
+    return source_;
+  }
+
+  /**
+   * @return    The end of source text
+   */
+  const char *source_end() const {
+    return source_end_;
+  }
+
+  /**
+   * @return    Whether the lexing failed
+   */
+  bool IsError() const {
+    return is_error_;
+  }
+
+ private:
+  /**
+   * @brief     Fill the ring buffer until it holds n tokens
+   */
+  void Fill(size_t n);
+
+  /**
+   * @return    A token pulled from the tokenizer or the extracted tokens
+   */
+  Token Pull();
+
+ private:
+  const Tokenizer *tokenizer_{nullptr};
+  LexContext context_;
+  const std::vector<Token> *tokens_{nullptr};
+  const TokenBuffer *buffer_{nullptr};
+  size_t tokens_pos_{0};
+  size_t tokens_last_{SIZE_MAX};
+  const char *source_{nullptr};
+  const char *source_end_{nullptr};
+
+  std::vector<Token> ring_;
+  size_t head_{0};
+  size_t count_{0};
+
+  Token eof_token_{kEofToken};
+  bool is_eof_{false};
+  bool is_error_{false};
+};
@@ -1,6 +1,11 @@
 // // Created by Dyinnz on 16-9-5.
 //
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
 #include "tokenizer.h"
 #include "simplelogger.h"
 
@@ -8,72 +13,200 @@ using std::vector;
 using std::string;
 using std::move;
 using std::pair;
+using std::shared_ptr;
 
 extern simple_logger::BaseLogger logger;
 
-bool Tokenizer::MatchString(const char *p, const std::string &str) {
-  if (str.empty()) {
-    return false;
+constexpr size_t Tokenizer::kMinChunkSize;
+constexpr size_t Tokenizer::kStreamBufferSize;
+
+namespace {
+
+/**
+ * @brief   A chunk of source text which is lexed speculatively
+ */
+struct LexChunk {
+  const char *start{nullptr};
+  LexContext ctx;
+  vector<Token> tokens;
+  // the token failed, if the chunk is not ok
+  Token error{kErrorToken};
+  bool is_ok{false};
+};
+
+/**
+ * @brief   Move the speculative tokens to the result, the context of chunk
+ *          synchronizes with the real context before the first moved token.
+ * @param chunk     the chunk lexed speculatively
+ * @param from      the index of first token to be moved
+ * @param ctx       the real context, will be moved to the end of chunk
+ * @param tokens    the result
+ */
+void SpliceChunk(const LexChunk &chunk,
+                 size_t from,
+                 LexContext &ctx,
+                 vector<Token> &tokens) {
+  for (size_t i = from; i < chunk.tokens.size(); ++i) {
+    // the LF following another LF is skipped
+    if (i == from && kLFSymbol == chunk.tokens[i].symbol
+        && kLFSymbol == ctx.last_symbol) {
+      continue;
+    }
+    tokens.push_back(chunk.tokens[i]);
   }
 
-  size_t i = 0;
-  while (i < str.size() && p + i < end_) {
-    if (p[i] != str[i]) {
-      return false;
+  if (from < chunk.tokens.size()) {
+    ctx.last_symbol = chunk.ctx.last_symbol;
+  }
+  ctx.curr = chunk.ctx.curr;
+}
+
+/**
+ * @return  the row and column of the offset in the whole source text, which
+ *          are only resolved when reporting errors
+ */
+pair<size_t, size_t> Locate(const LexContext &ctx, uint32_t offset) {
+  LineIndex lines(ctx.beg, ctx.beg + offset);
+  size_t row = lines.Row(offset);
+  if (1 == row) {
+    return {ctx.beg_row, ctx.beg_column + offset};
+  }
+  return {ctx.beg_row + row - 1, lines.Column(offset)};
+}
+
+/**
+ * @brief   Report the lexical error at the current position
+ */
+void ReportError(const LexContext &ctx) {
+  auto position = Locate(ctx, static_cast<uint32_t>(ctx.curr - ctx.beg));
+  logger.error("could not get next token at ({}, {})",
+               position.first,
+               position.second);
+}
+
+void ReportOutOfRange(const LexContext &ctx, const Token &token) {
+  auto position = Locate(ctx, token.offset);
+  logger.error("integer literal {} is out of range at ({}, {})",
+               token.text(ctx.beg),
+               position.first,
+               position.second);
+}
+
+/**
+ * @brief   Move the begin of context to its current position, the row and
+ *          column of begin are updated by the LFs skipped
+ */
+void AdvanceBegin(LexContext &ctx) {
+  const char *p = ctx.beg;
+  const char *line_start = nullptr;
+  while (p < ctx.curr) {
+    p = static_cast<const char *>(memchr(p, '\n', ctx.curr - p));
+    if (!p) {
+      break;
     }
-    i += 1;
+    p += 1;
+    line_start = p;
+    ctx.beg_row += 1;
   }
-  return (p + i) <= end_ && i == str.size();
+
+  if (line_start) {
+    ctx.beg_column = ctx.curr - line_start;
+  } else {
+    ctx.beg_column += ctx.curr - ctx.beg;
+  }
+  ctx.beg = ctx.curr;
 }
 
-const char *Tokenizer::SkipComment(const char *p) {
-  if (MatchString(p, line_comment_start_)) {
-    p += line_comment_start_.size();
+} // end of namespace
 
-    while (p < end_ && *p != '\n') {
-      p += 1;
+void Tokenizer::Intern(const LexContext &ctx,
+                       Token &token,
+                       StringInterner *interner) const {
+  if (intern_set_.end() != intern_set_.find(token.symbol)) {
+    token.value = interner
+                  ? interner->Intern(ctx.beg + token.offset, token.length)
+                  : kNotInterned;
+  }
+}
+
+bool Tokenizer::DecodeInteger(const LexContext &ctx, Token &token) const {
+  if (integer_set_.end() == integer_set_.find(token.symbol)) {
+    return true;
+  }
+
+  // detect the base as C, the decoding stops at the first invalid digit
+  const char *p = ctx.beg + token.offset;
+  const char *end = p + token.length;
+  uint32_t base = 10;
+  if (end - p > 2 && '0' == p[0] && ('x' == p[1] || 'X' == p[1])) {
+    base = 16;
+    p += 2;
+  } else if (end - p > 1 && '0' == p[0]) {
+    base = 8;
+    p += 1;
+  }
+
+  int64_t value = 0;
+  for (; p < end; ++p) {
+    uint32_t digit = base;
+    if ('0' <= *p && *p <= '9') {
+      digit = *p - '0';
+    } else if ('a' <= *p && *p <= 'f') {
+      digit = *p - 'a' + 10;
+    } else if ('A' <= *p && *p <= 'F') {
+      digit = *p - 'A' + 10;
     }
-    if (p < end_) {
-      // get a LF
-      curr_row_ += 1;
-      curr_row_pos_ = p + 1;
-      return p + 1;
-    } else {
-      // get EOF
-      return p;
+    if (digit >= base) {
+      break;
     }
+    value = value * base + digit;
+    if (value > INT32_MAX) {
+      return false;
+    }
+  }
+
+  token.value = static_cast<uint32_t>(value);
+  return true;
+}
+
+bool Tokenizer::SkipLineComment(LexContext &ctx) const {
+  const char *p = static_cast<const char *>(
+      memchr(ctx.curr, '\n', ctx.end - ctx.curr));
+  // skip the LF, or get EOF
+  ctx.curr = p ? p + 1 : ctx.end;
+  return nullptr != p;
+}
 
-  } else if (MatchString(p, block_comment_start_)) {
-    p += block_comment_start_.size();
+bool Tokenizer::SkipBlockComment(LexContext &ctx, uint32_t &state) const {
+  const uint32_t matched = static_cast<uint32_t>(block_comment_end_.size());
 
-    while (p < end_ && !MatchString(p, block_comment_end_)) {
-      if (*p == '\n') {
-        // get a LF
-        curr_row_ += 1;
-        curr_row_pos_ = p + 1;
+  const char *p = ctx.curr;
+  while (p < ctx.end && state != matched) {
+    if (0 == state) {
+      // jump to the next possible start of comment end
+      p = byte_scanner::FindBytes(p, ctx.end, block_end_start_);
+      if (p == ctx.end) {
+        break;
       }
-      p += 1;
-    }
-    if (p < end_) {
-      return p + block_comment_end_.size();
-    } else {
-      return p;
     }
 
-  } else {
-    return p;
+    state = block_end_table_[state * 256 + static_cast<unsigned char>(*p)];
+    p += 1;
   }
+  ctx.curr = p;
+  return state == matched;
 }
 
-Token Tokenizer::GetNextToken(const char *&p) {
-  assert(p < end_);
+Token Tokenizer::GetNextToken(LexContext &ctx) const {
+  const char *p = ctx.curr;
+  assert(p < ctx.end);
 
   Token longest_token = kErrorToken;
 
   const DFANode *curr_node = token_dfa_->start();
 
   const char *s = p;
-  while (s != end_) {
+  while (s != ctx.end) {
     const DFANode *next_node = curr_node->GetNextNode(*s);
 
     if (next_node) {
@@ -91,88 +224,533 @@ Token Tokenizer::GetNextToken(const char *&p) {
     }
   }
 
-  longest_token.text = std::string(p, s);
-  longest_token.row = curr_row_;
-  longest_token.column = p - curr_row_pos_;
-  p = s;
+  longest_token.offset = static_cast<uint32_t>(p - ctx.beg);
+  longest_token.length = static_cast<uint32_t>(s - p);
+  ctx.curr = s;
 
   // logger.debug("{}(): {}", __func__, to_string(longest_token));
   return longest_token;
 }
 
-bool Tokenizer::LexicalAnalyze(const string &s, vector<Token> &tokens) {
-  return LexicalAnalyze(s.c_str(), s.c_str() + s.length(), tokens);
+bool Tokenizer::Relex(string &source,
+                      vector<Token> &tokens,
+                      uint32_t edit_offset,
+                      uint32_t removed_len,
+                      const string &inserted_text,
+                      StringInterner *interner) const {
+  source.replace(edit_offset, removed_len, inserted_text);
+  return Relex(source.c_str(),
+               source.c_str() + source.size(),
+               tokens,
+               edit_offset,
+               removed_len,
+               static_cast<uint32_t>(inserted_text.size()),
+               interner);
+}
+
+bool Tokenizer::Relex(const char *beg,
+                      const char *end,
+                      vector<Token> &tokens,
+                      uint32_t edit_offset,
+                      uint32_t removed_len,
+                      uint32_t inserted_len,
+                      StringInterner *interner) const {
+  LexContext ctx;
+  if (!Reset(ctx, beg, end, interner)) {
+    return false;
+  }
+
+  // restart after the last token which ends before the edit, the text and
+  // the following char of it are unchanged
+  auto restart = std::lower_bound(
+      tokens.begin(), tokens.end(), edit_offset,
+      [](const Token &token, uint32_t offset) {
+        return token.offset + token.length < offset;
+      }) - tokens.begin();
+  if (restart > 0) {
+    restart -= 1;
+    ctx.curr = beg + tokens[restart].offset;
+    ctx.last_symbol = restart > 0 ? tokens[restart - 1].symbol : kEofSymbol;
+  }
+
+  // the old tokens after the edit are shifted
+  const uint32_t edit_end = edit_offset + removed_len;
+  const int64_t delta = static_cast<int64_t>(inserted_len) - removed_len;
+  size_t old = restart;
+  while (old < tokens.size() && tokens[old].offset < edit_end) {
+    old += 1;
+  }
+
+  vector<Token> relexed;
+  Token token = kEofToken;
+  bool is_sync = false;
+  while (!is_sync) {
+    if (!NextToken(ctx, token)) {
+      return false;
+    }
+    if (kEofSymbol == token.symbol) {
+      break;
+    }
+    relexed.push_back(token);
+
+    while (old < tokens.size() && tokens[old].offset + delta < token.offset) {
+      old += 1;
+    }
+    if (old < tokens.size() && tokens[old].offset + delta == token.offset
+        && tokens[old].length == token.length
+        && tokens[old].symbol == token.symbol) {
+      is_sync = true;
+    }
+  }
+
+  // splice the tokens
+  vector<Token> tail;
+  if (is_sync) {
+    tail.reserve(tokens.size() - old - 1);
+    for (size_t i = old + 1; i < tokens.size(); ++i) {
+      tail.push_back(tokens[i]);
+      tail.back().offset = static_cast<uint32_t>(tokens[i].offset + delta);
+    }
+  }
+  tokens.erase(tokens.begin() + restart, tokens.end());
+  tokens.insert(tokens.end(), relexed.begin(), relexed.end());
+  tokens.insert(tokens.end(), tail.begin(), tail.end());
+  return true;
+}
+
+template<class Tokens>
+bool Tokenizer::LexRange(LexContext &ctx,
+                         Tokens &tokens,
+                         Token *error) const {
+  Token token = kEofToken;
+  while (NextToken(ctx, token)) {
+    if (kEofSymbol == token.symbol) {
+      return true;
+    }
+    tokens.push_back(token);
+  }
+  if (error) {
+    *error = token;
+  }
+  return false;
+}
+
+bool Tokenizer::LexicalAnalyze(const string &s,
+                               vector<Token> &tokens,
+                               StringInterner *interner) const {
+  return LexicalAnalyze(s.c_str(), s.c_str() + s.length(), tokens, interner);
+}
+
+bool Tokenizer::LexicalAnalyze(const char *beg,
+                               const char *end,
+                               vector<Token> &tokens,
+                               StringInterner *interner) const {
+  LexContext ctx;
+  if (!Reset(ctx, beg, end, interner)) {
+    return false;
+  }
+
+  return LexRange(ctx, tokens);
 }
 
 bool Tokenizer::LexicalAnalyze(const char *beg,
                                const char *end,
-                               vector<Token> &tokens) {
+                               TokenBuffer &tokens,
+                               StringInterner *interner) const {
+  LexContext ctx;
+  if (!Reset(ctx, beg, end, interner)) {
+    return false;
+  }
+
+  return LexRange(ctx, tokens);
+}
+
+bool Tokenizer::LexicalAnalyzeParallel(const char *beg,
+                                       const char *end,
+                                       vector<Token> &tokens,
+                                       size_t thread_num,
+                                       size_t min_chunk_size,
+                                       StringInterner *interner) const {
+  if (0 == thread_num) {
+    thread_num = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t chunk_num = std::min(thread_num,
+                              (end - beg) / std::max<size_t>(min_chunk_size, 1));
+  if (chunk_num <= 1) {
+    return LexicalAnalyze(beg, end, tokens, interner);
+  }
+
+  LexContext ctx;
+  if (!Reset(ctx, beg, end)) {
+    return false;
+  }
+
+  // split the source text at LFs
+  vector<LexChunk> chunks;
+  const char *start = beg;
+  for (size_t i = 1; i <= chunk_num && start < end; ++i) {
+    const char *stop = end;
+    if (i < chunk_num) {
+      stop = std::max(start, beg + (end - beg) / chunk_num * i);
+      stop = static_cast<const char *>(memchr(stop, '\n', end - stop));
+      stop = stop ? stop + 1 : end;
+    }
+
+    chunks.emplace_back();
+    LexChunk &chunk = chunks.back();
+    chunk.start = start;
+    chunk.ctx = LexContext(beg, end);
+    chunk.ctx.curr = start;
+    chunk.ctx.stop = stop;
+    chunk.ctx.report_error = false;
+    start = stop;
+  }
+
+  // lex speculatively, assuming that each chunk begins at a new token
+  vector<std::thread> threads;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    threads.emplace_back([this, &chunks, i]() {
+      chunks[i].is_ok = LexRange(chunks[i].ctx, chunks[i].tokens,
+                                 &chunks[i].error);
+    });
+  }
+  chunks.front().is_ok = LexRange(chunks.front().ctx, chunks.front().tokens,
+                                  &chunks.front().error);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // merge in order
+  size_t first = tokens.size();
+  for (auto &chunk : chunks) {
+    if (ctx.curr == chunk.start) {
+      // the speculation is right
+      SpliceChunk(chunk, 0, ctx, tokens);
+
+    } else {
+      // a comment or token crosses the boundary, relex until a token is the
+      // same as the speculative one, then the rest are the same
+      ctx.stop = chunk.ctx.stop;
+      bool is_sync = false;
+      size_t i = 0;
+      Token token = kEofToken;
+
+      while (!is_sync) {
+        if (!NextToken(ctx, token)) {
+          return false;
+        }
+        if (kEofSymbol == token.symbol) {
+          break;
+        }
+        tokens.push_back(token);
+
+        while (i < chunk.tokens.size()
+            && chunk.tokens[i].offset < token.offset) {
+          i += 1;
+        }
+        if (i < chunk.tokens.size() && chunk.tokens[i].offset == token.offset) {
+          SpliceChunk(chunk, i + 1, ctx, tokens);
+          is_sync = true;
+        }
+      }
+      if (!is_sync) {
+        continue;
+      }
+    }
+
+    // the error is after the tokens spliced, so it is also found by the
+    // serial lexing, and reported in the same way
+    if (!chunk.is_ok) {
+      if (kErrorSymbol == chunk.error.symbol) {
+        ReportError(ctx);
+      } else {
+        ReportOutOfRange(ctx, chunk.error);
+      }
+      return false;
+    }
+  }
+
+  if (!intern_set_.empty()) {
+    for (size_t i = first; i < tokens.size(); ++i) {
+      Intern(ctx, tokens[i], interner);
+    }
+  }
+  return true;
+}
+
+bool Tokenizer::Reset(LexContext &ctx,
+                      const char *beg,
+                      const char *end,
+                      StringInterner *interner) const {
   assert(token_dfa_);
 
-  beg_ = beg;
-  end_ = end;
+  // token only records 32-bit offset
+  if (static_cast<size_t>(end - beg) > UINT32_MAX) {
+    logger.error("source text is too large: {} bytes", end - beg);
+    return false;
+  }
 
-  curr_row_ = 1;
-  curr_row_pos_ = beg_;
+  ctx = LexContext(beg, end);
+  ctx.interner = interner;
+  return true;
+}
 
-  curr_ = beg;
+bool Tokenizer::NextToken(LexContext &ctx, Token &token) const {
   while (true) {
-    const char *new_curr_ = curr_;
-    do {
-      curr_ = new_curr_;
-      new_curr_ = SkipComment(curr_);
-    } while (curr_ != new_curr_);
+    // skip the single-byte ignored tokens in a batch
+    if (!skip_set_.empty() && ctx.curr < ctx.stop) {
+      ctx.curr = byte_scanner::SkipBytes(ctx.curr, ctx.stop, skip_set_);
+    }
 
-    if (curr_ >= end_) break;
+    if (ctx.curr >= ctx.stop) {
+      token = kEofToken;
+      token.offset = static_cast<uint32_t>(ctx.curr - ctx.beg);
+      return true;
+    }
 
-    Token token = GetNextToken(curr_);
+    token = GetNextToken(ctx);
 
     // error
     if (token.symbol == kErrorSymbol) {
-      logger.error("could not get next token at ({}, {})",
-                   curr_row_,
-                   curr_ - curr_row_pos_);
+      if (ctx.report_error) {
+        ReportError(ctx);
+      }
       return false;
     }
-    // record line no.
-    if (token.symbol == kLFSymbol) {
-      curr_row_ += 1;
-      curr_row_pos_ = curr_;
-      token.text = "\\n";
-    }
-    // skip ignored token
-    if (ignore_set_.end() == ignore_set_.find(token.symbol)) {
-      if (!(token.symbol == kLFSymbol && !tokens.empty()
-          && tokens.back().symbol == kLFSymbol)) {
-        tokens.push_back(move(token));
+    // skip comments, a comment starting before the stop position could
+    // extend after it
+    if (token.symbol == kLineCommentSymbol) {
+      SkipLineComment(ctx);
+      continue;
+    }
+    if (token.symbol == kBlockCommentSymbol) {
+      uint32_t state = 0;
+      SkipBlockComment(ctx, state);
+      continue;
+    }
+
+    TokenAction action = ProcessToken(ctx, token);
+    if (kSkipToken != action) {
+      return kEmitToken == action;
+    }
+  }
+}
+
+Tokenizer::TokenAction Tokenizer::ProcessToken(LexContext &ctx,
+                                               Token &token) const {
+  // skip ignored token, and the LF following another LF
+  if (ignore_set_.end() != ignore_set_.find(token.symbol)
+      || (token.symbol == kLFSymbol && ctx.last_symbol == kLFSymbol)) {
+    return kSkipToken;
+  }
+
+  ctx.last_symbol = token.symbol;
+  Intern(ctx, token, ctx.interner);
+  if (!DecodeInteger(ctx, token)) {
+    if (ctx.report_error) {
+      ReportOutOfRange(ctx, token);
+    }
+    return kFailToken;
+  }
+  return kEmitToken;
+}
+
+bool Tokenizer::LexicalAnalyze(std::istream &in,
+                               const TokenSink &sink,
+                               size_t buffer_size,
+                               StringInterner *interner) const {
+  auto read = [&in](char *buffer, size_t size) -> ptrdiff_t {
+    in.read(buffer, size);
+    return in.bad() ? -1 : in.gcount();
+  };
+  return LexStream(read, sink, buffer_size, interner);
+}
+
+bool Tokenizer::LexicalAnalyze(int fd,
+                               const TokenSink &sink,
+                               size_t buffer_size,
+                               StringInterner *interner) const {
+  auto read = [fd](char *buffer, size_t size) -> ptrdiff_t {
+    ssize_t n = 0;
+    do {
+      n = ::read(fd, buffer, size);
+    } while (n < 0 && EINTR == errno);
+    return n;
+  };
+  return LexStream(read, sink, buffer_size, interner);
+}
+
+bool Tokenizer::LexStream(const StreamReader &read,
+                          const TokenSink &sink,
+                          size_t buffer_size,
+                          StringInterner *interner) const {
+  assert(token_dfa_);
+
+  // token only records 32-bit offset
+  if (0 == buffer_size || buffer_size > UINT32_MAX) {
+    logger.error("invalid buffer size: {}", buffer_size);
+    return false;
+  }
+
+  vector<char> buffer(buffer_size);
+  LexContext ctx(buffer.data(), buffer.data());
+  ctx.interner = interner;
+  bool is_eof = false;
+  // the comment crossing the end of buffer
+  Symbol comment = kEofSymbol;
+  uint32_t block_end_state = 0;
+
+  while (true) {
+    // move the unfinished lexeme to the front, then fill the rest
+    AdvanceBegin(ctx);
+    size_t size = ctx.end - ctx.curr;
+    memmove(buffer.data(), ctx.curr, size);
+    while (!is_eof && size < buffer.size()) {
+      ptrdiff_t n = read(buffer.data() + size, buffer.size() - size);
+      if (n < 0) {
+        logger.error("failed to read the source text");
+        return false;
+      }
+      is_eof = 0 == n;
+      size += n;
+    }
+    ctx.beg = ctx.curr = buffer.data();
+    ctx.end = ctx.stop = buffer.data() + size;
+
+    if (kLineCommentSymbol == comment && SkipLineComment(ctx)) {
+      comment = kEofSymbol;
+    } else if (kBlockCommentSymbol == comment
+        && SkipBlockComment(ctx, block_end_state)) {
+      comment = kEofSymbol;
+    }
+
+    while (true) {
+      if (!skip_set_.empty() && ctx.curr < ctx.end) {
+        ctx.curr = byte_scanner::SkipBytes(ctx.curr, ctx.end, skip_set_);
+      }
+      if (ctx.curr >= ctx.end) {
+        if (is_eof) {
+          return true;
+        }
+        break;
+      }
+
+      const char *start = ctx.curr;
+      Token token = GetNextToken(ctx);
+
+      // the lexeme reaching the end may be continued by the following text
+      if (ctx.curr == ctx.end && !is_eof) {
+        if (start == ctx.beg) {
+          logger.error("the lexeme is longer than the buffer at ({}, {})",
+                       ctx.beg_row,
+                       ctx.beg_column);
+          return false;
+        }
+        ctx.curr = start;
+        break;
+      }
+
+      if (token.symbol == kErrorSymbol) {
+        ReportError(ctx);
+        return false;
+      }
+      if (token.symbol == kLineCommentSymbol) {
+        if (!SkipLineComment(ctx)) {
+          comment = kLineCommentSymbol;
+        }
+        continue;
+      }
+      if (token.symbol == kBlockCommentSymbol) {
+        block_end_state = 0;
+        if (!SkipBlockComment(ctx, block_end_state)) {
+          comment = kBlockCommentSymbol;
+        }
+        continue;
+      }
+
+      TokenAction action = ProcessToken(ctx, token);
+      if (kFailToken == action) {
+        return false;
+      }
+      if (kEmitToken == action && !sink(token, ctx.beg)) {
+        return true;
       }
     }
   }
+}
 
-  return true;
+namespace {
+
+/**
+ * @return  the regular expression matching the string literally
+ */
+string EscapeRegex(const string &s) {
+  string result;
+  for (char c : s) {
+    if (strchr("\\.*+?()[]|", c)) {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
 }
 
-TokenizerBuilder &
-TokenizerBuilder::SetPatterns(const std::vector<TokenPattern> &patterns) {
-  ResetPriority();
+} // end of namespace
 
+TokenizerBuilder &TokenizerBuilder::AddPattern(const TokenPattern &pattern,
+                                               size_t index) {
+  index = std::min(index, patterns_.size());
+  patterns_.insert(patterns_.begin() + index, pattern);
+  priorities_.insert(priorities_.begin() + index, Node::kUnsetInt);
+  return *this;
+}
+
+bool TokenizerBuilder::RemovePattern(const string &regex) {
+  auto iter = std::find_if(patterns_.begin(), patterns_.end(),
+                           [&regex](const TokenPattern &pattern) {
+                             return pattern.first == regex;
+                           });
+  if (patterns_.end() == iter) {
+    return false;
+  }
+
+  size_t index = iter - patterns_.begin();
+  int priority = priorities_[index];
+  patterns_.erase(iter);
+  priorities_.erase(priorities_.begin() + index);
+  if (Node::kUnsetInt == priority) {
+    // not built yet
+    return true;
+  }
+
+  auto added = std::find_if(added_dfas_.begin(), added_dfas_.end(),
+                            [priority](const pair<int, shared_ptr<DFA>> &p) {
+                              return priority == p.first;
+                            });
+  if (added_dfas_.end() != added) {
+    added_dfas_.erase(added);
+    is_added_removed_ = true;
+  } else {
+    base_dfa_.reset();
+  }
+  return true;
+}
+
+shared_ptr<DFA> TokenizerBuilder::CompileDFA(
+    const vector<TokenPattern> &patterns, int first_priority) {
   RegexParser re_parser;
-  vector<Symbol> priority_to_symbol(patterns.size());
   NFAComponent *result_comp = nullptr;
+  int next_priority = first_priority;
 
   for (auto &p : patterns) {
-    auto &s = p.first;
-    auto symbol = p.second;
-
-    NFAComponent *comp = re_parser.ParseToNFAComponent(s);
+    NFAComponent *comp = re_parser.ParseToNFAComponent(p.first);
     if (!comp) {
       logger.error("{}(): nullptr NFAComponent pointer", __func__);
-      return *this;
+      is_error_ = true;
+      return nullptr;
     }
 
-    int next_priority = NextPriority();
-    comp->end()->set_priority(next_priority);
-    priority_to_symbol[next_priority] = symbol;
+    comp->end()->set_priority(next_priority++);
 
     if (!result_comp) {
       result_comp = comp;
@@ -185,30 +763,158 @@ TokenizerBuilder::SetPatterns(const std::vector<TokenPattern> &patterns) {
   auto token_nfa = re_parser.GetNFAManager().BuildNFA(result_comp);
   if (!token_nfa) {
     is_error_ = true;
-    return *this;
+    return nullptr;
   }
 
   auto normal_dfa = ConvertNFAToDFA(token_nfa);
   if (!normal_dfa) {
     is_error_ = true;
-    return *this;
+    return nullptr;
   }
 
   auto min_dfa = MinimizeDFA(normal_dfa);
   if (!min_dfa) {
     is_error_ = true;
-    return *this;
+    return nullptr;
+  }
+  return min_dfa;
+}
+
+void TokenizerBuilder::BuildTokenDFA() {
+  // the comment starts have the highest priority
+  vector<TokenPattern> patterns;
+  if (!line_comment_start_.empty()) {
+    patterns.emplace_back(EscapeRegex(line_comment_start_),
+                          kLineCommentSymbol);
+  }
+  if (!block_comment_start_.empty()) {
+    patterns.emplace_back(EscapeRegex(block_comment_start_),
+                          kBlockCommentSymbol);
+  }
+  comment_pattern_num_ = patterns.size();
+  patterns.insert(patterns.end(), patterns_.begin(), patterns_.end());
+
+  added_dfas_.clear();
+  is_added_removed_ = false;
+  base_dfa_ = CompileDFA(patterns, 0);
+  if (!base_dfa_) {
+    return;
+  }
+
+  // the priority is the index of pattern
+  vector<Symbol> priority_to_symbol;
+  for (auto &p : patterns) {
+    priority_to_symbol.push_back(p.second);
+  }
+  priorities_.clear();
+  for (size_t i = 0; i < patterns_.size(); ++i) {
+    priorities_.push_back(static_cast<int>(comment_pattern_num_ + i));
   }
 
   tokenizer_.priority_to_symbol_ = std::move(priority_to_symbol);
-  tokenizer_.token_dfa_ = min_dfa;
+  tokenizer_.token_dfa_ = base_dfa_;
+}
 
-  return *this;
+void TokenizerBuilder::BuildAddedDFAs() {
+  auto &priority_to_symbol = tokenizer_.priority_to_symbol_;
+  bool is_changed = is_added_removed_;
+
+  for (size_t i = 0; i < patterns_.size(); ++i) {
+    if (Node::kUnsetInt != priorities_[i]) {
+      continue;
+    }
+    int priority = static_cast<int>(priority_to_symbol.size());
+    auto dfa = CompileDFA({patterns_[i]}, priority);
+    if (!dfa) {
+      return;
+    }
+    priority_to_symbol.push_back(patterns_[i].second);
+    priorities_[i] = priority;
+    added_dfas_.emplace_back(priority, dfa);
+    is_changed = true;
+  }
+  if (!is_changed) {
+    return;
+  }
+
+  // the comment starts are always the highest, then the order of patterns
+  vector<size_t> rank(priority_to_symbol.size(), SIZE_MAX);
+  for (size_t i = 0; i < comment_pattern_num_; ++i) {
+    rank[i] = i;
+  }
+  for (size_t i = 0; i < priorities_.size(); ++i) {
+    rank[priorities_[i]] = comment_pattern_num_ + i;
+  }
+  auto is_higher = [&rank](int lhs, int rhs) {
+    return rank[lhs] < rank[rhs];
+  };
+
+  shared_ptr<DFA> token_dfa = base_dfa_;
+  for (auto &p : added_dfas_) {
+    token_dfa = UnionDFA(*token_dfa, *p.second, is_higher);
+  }
+  tokenizer_.token_dfa_ = token_dfa;
+  is_added_removed_ = false;
+}
+
+void TokenizerBuilder::BuildBlockEndTable() {
+  const string &end = tokenizer_.block_comment_end_;
+  vector<uint32_t> &table = tokenizer_.block_end_table_;
+  table.assign(end.size() * 256, 0);
+  tokenizer_.block_end_start_ = byte_scanner::ByteSet();
+  if (end.empty()) {
+    return;
+  }
+  tokenizer_.block_end_start_.Insert(end[0]);
+
+  // the state falling back to when mismatching
+  uint32_t fallback = 0;
+  table[static_cast<unsigned char>(end[0])] = 1;
+  for (uint32_t state = 1; state < end.size(); ++state) {
+    auto c = static_cast<unsigned char>(end[state]);
+    std::copy(&table[fallback * 256], &table[fallback * 256] + 256,
+              &table[state * 256]);
+    table[state * 256 + c] = state + 1;
+    fallback = table[fallback * 256 + c];
+  }
+}
+
+void TokenizerBuilder::BuildSkipSet() {
+  tokenizer_.skip_set_ = byte_scanner::ByteSet();
+  if (!tokenizer_.token_dfa_) {
+    return;
+  }
+
+  const DFANode *start = tokenizer_.token_dfa_->start();
+  for (auto &edge : start->edges()) {
+    const DFANode *node = edge.second;
+    // the token is exactly one byte if no more byte could follow
+    if (!node->IsEnd() || !node->edges().empty()) {
+      continue;
+    }
+    Symbol symbol = tokenizer_.priority_to_symbol_[node->priority()];
+    if (tokenizer_.ignore_set_.end() == tokenizer_.ignore_set_.find(symbol)) {
+      continue;
+    }
+    // the set is small, other ignored bytes are still lexed by the DFA
+    if (!tokenizer_.skip_set_.Insert(edge.first)) {
+      break;
+    }
+  }
 }
 
 Tokenizer TokenizerBuilder::Build() {
   if (tokenizer_.ignore_set_.empty()) {
     tokenizer_.ignore_set_.insert(kSpaceSymbol);
   }
-  return std::move(tokenizer_);
+
+  if (!base_dfa_) {
+    BuildTokenDFA();
+  } else {
+    BuildAddedDFAs();
+  }
+  BuildBlockEndTable();
+  BuildSkipSet();
+
+  return tokenizer_;
 }
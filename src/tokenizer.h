@@ -4,8 +4,14 @@
 
 #pragma once
 
+#include <functional>
+#include <istream>
+#include "byte_scanner.h"
 #include "finite_automaton.h"
+#include "line_index.h"
 #include "regex_parser.h"
+#include "string_interner.h"
+#include "token_buffer.h"
 
 using namespace regular_expression;
 
@@ -13,6 +19,47 @@ using namespace regular_expression;
 
 typedef std::pair<std::string, Symbol> TokenPattern;
 
+/**
+ * @brief   The receiver of tokens lexed from a stream. The offset of token is
+ *          relative to the source, which is only valid during the call.
+ *          Return false to stop lexing.
+ */
+typedef std::function<bool(const Token &token, const char *source)> TokenSink;
+
+/**
+ * @brief   The position information of lexing a source text.
+ *
+ * @details The context is created for each lexing, so that a tokenizer keeps
+ *          no state of lexing, and could be shared by multiple threads.
+ */
+struct LexContext {
+  LexContext() = default;
+  LexContext(const char *beg, const char *end)
+      : beg(beg), end(end), stop(end), curr(beg) {}
+
+  const char *beg{nullptr};
+  const char *end{nullptr};
+  /**
+   * @brief     no token starts at or after the stop position, but a token or
+   *            comment starts before it could extend to the end
+   */
+  const char *stop{nullptr};
+  const char *curr{nullptr};
+  /**
+   * @brief     the row and column of beg in the whole source text, which are
+   *            not the first ones only if the text is read from a stream
+   */
+  size_t beg_row{1};
+  size_t beg_column{0};
+  Symbol last_symbol{kEofSymbol};
+  bool report_error{true};
+  /**
+   * @brief     the lexemes of symbols in the intern set are interned to it,
+   *            their values are kNotInterned if it is nullptr
+   */
+  StringInterner *interner{nullptr};
+};
+
 /**
  * @brief   A common Tokenizer .
  *
@@ -21,6 +68,10 @@ typedef std::pair<std::string, Symbol> TokenPattern;
  *
  *          The tokenizer should only be created by TokenizerBuilder instead of
  *          creating directly.
+ *
+ *          A built tokenizer is immutable, all the lexing state is kept in
+ *          LexContext, so it is safe to lex multiple inputs concurrently
+ *          with one tokenizer.
  */
 class Tokenizer {
  public:
@@ -31,72 +82,260 @@ class Tokenizer {
     return &*token_dfa_;
   }
 
-  const char *CurrentPos() {
-    return curr_;
-  }
+  /**
+   * @brief     Start lexing a new source text, then tokens could be pulled
+   *            one by one by calling NextToken()
+   * @param ctx     the lexing context to be initialized
+   * @param beg     the begin position of source text
+   * @param end     the end position of source text
+   * @param interner    the interner of lexemes, could be nullptr
+   * @return        whether the source text could be lexed
+   */
+  bool Reset(LexContext &ctx,
+             const char *beg,
+             const char *end,
+             StringInterner *interner = nullptr) const;
+
+  /**
+   * @brief     Extract the next token which is not ignored
+   * @param ctx     the lexing context
+   * @param token   the token extracted, or kEofToken at the end of source text
+   * @return        whether succeed
+   */
+  bool NextToken(LexContext &ctx, Token &token) const;
 
   /**
    * @brief     Extracted next token on current position
-   * @param p   current text position
+   * @param ctx     the lexing context, the current position will be moved
    * @return    the token following current position
    */
-  Token GetNextToken(const char *&p);
+  Token GetNextToken(LexContext &ctx) const;
 
   /**
    * @param s       the source text
-   * @param tokens  the tokens extracted
+   * @param tokens  the tokens extracted, which refer to the source text
+   * @param interner    the interner of lexemes, could be nullptr
    * @return        whether succeed
    */
   bool LexicalAnalyze(const std::string &s,
-                      std::vector<Token> &tokens);
+                      std::vector<Token> &tokens,
+                      StringInterner *interner = nullptr) const;
+
+  /**
+   * @brief     The source text is splited at LFs into chunks, which are lexed
+   *            speculatively by multiple threads. Then the tokens are merged
+   *            in order. If a comment or token crosses the boundary of
+   *            chunks, the following chunk is relexed until it synchronizes
+   *            with the speculative result again.
+   *
+   * @param beg         the begin position of source text
+   * @param end         the end position of source text
+   * @param tokens      the tokens extracted, the same as LexicalAnalyze()
+   * @param thread_num  the number of threads, 0 means the hardware
+   *                    concurrency
+   * @param min_chunk_size  the source text is lexed serially if it could not
+   *                        be splited into chunks larger than this
+   * @param interner    the interner of lexemes, could be nullptr. The lexemes
+   *                    are interned in order after merging, so the IDs are
+   *                    the same as lexing serially.
+   * @return        whether succeed
+   */
+  bool LexicalAnalyzeParallel(const char *beg,
+                              const char *end,
+                              std::vector<Token> &tokens,
+                              size_t thread_num = 0,
+                              size_t min_chunk_size = kMinChunkSize,
+                              StringInterner *interner = nullptr) const;
+
+  static constexpr size_t kMinChunkSize = 1 << 20;
+
+  /**
+   * @brief     Update the tokens after the source text is edited.
+   *
+   * @details   The lexing restarts at the last token ending before the edit,
+   *            since a token only depends on its text and the following char.
+   *            It stops once a new token is the same as an old token after
+   *            the edit, and the rest old tokens are shifted. So that the
+   *            cost is proportional to the edit size.
+   *
+   * @param beg         the begin position of edited source text
+   * @param end         the end position of edited source text
+   * @param tokens      the tokens of source text before editing, will be
+   *                    updated. It is unchanged if failed.
+   * @param edit_offset the offset where the edit happens
+   * @param removed_len the length of old text removed
+   * @param inserted_len    the length of new text inserted
+   * @param interner    the interner of lexemes, should be the one used to
+   *                    lex the old tokens
+   * @return        whether succeed
+   */
+  bool Relex(const char *beg,
+             const char *end,
+             std::vector<Token> &tokens,
+             uint32_t edit_offset,
+             uint32_t removed_len,
+             uint32_t inserted_len,
+             StringInterner *interner = nullptr) const;
+
+  /**
+   * @brief     Apply the edit to the source text, then update the tokens
+   * @param source  the source text to be edited
+   * @see       Relex() above
+   */
+  bool Relex(std::string &source,
+             std::vector<Token> &tokens,
+             uint32_t edit_offset,
+             uint32_t removed_len,
+             const std::string &inserted_text,
+             StringInterner *interner = nullptr) const;
+
+  /**
+   * @param beg     the begin position of source text
+   * @param end     the end position of source text
+   * @param tokens  the tokens extracted, their offsets are relative to beg
+   * @param interner    the interner of lexemes, could be nullptr
+   * @return        whether succeed
+   */
+  bool LexicalAnalyze(const char *beg,
+                      const char *end,
+                      std::vector<Token> &tokens,
+                      StringInterner *interner = nullptr) const;
 
   /**
    * @param beg     the begin position of source text
    * @param end     the end position of source text
-   * @param tokens  the tokens extracted
+   * @param tokens  the tokens extracted into the arrays of buffer
+   * @param interner    the interner of lexemes, could be nullptr
    * @return        whether succeed
    */
   bool LexicalAnalyze(const char *beg,
                       const char *end,
-                      std::vector<Token> &tokens);
+                      TokenBuffer &tokens,
+                      StringInterner *interner = nullptr) const;
+
+  /**
+   * @brief     Lex the source text read from a stream through a fixed-size
+   *            buffer, so that the memory is bounded by the buffer size
+   *            instead of the text size. The lexeme or comment crossing the
+   *            end of buffer is carried to the next refill.
+   *
+   * @param in          the input stream
+   * @param sink        the receiver of tokens
+   * @param buffer_size the size of buffer, a lexeme longer than it is an
+   *                    error, while a comment is not
+   * @param interner    the interner of lexemes, could be nullptr
+   * @return            whether succeed, stopping by the sink is not a failure
+   */
+  bool LexicalAnalyze(std::istream &in,
+                      const TokenSink &sink,
+                      size_t buffer_size = kStreamBufferSize,
+                      StringInterner *interner = nullptr) const;
+
+  /**
+   * @param fd  the file descriptor to read, the others are the same as
+   *            reading from std::istream
+   */
+  bool LexicalAnalyze(int fd,
+                      const TokenSink &sink,
+                      size_t buffer_size = kStreamBufferSize,
+                      StringInterner *interner = nullptr) const;
+
+  static constexpr size_t kStreamBufferSize = 1 << 20;
 
  private:
   friend class TokenizerBuilder;
 
   /**
-   * @brief         Auxiliary function, used to match the mark of comment
-   * @param p       current position
-   * @param str     string to be matched
-   * @return        whether match
+   * @brief     Read at most size bytes into the buffer
+   * @return    the number of bytes read, 0 at the end, or negative if failed
+   */
+  typedef std::function<ptrdiff_t(char *buffer, size_t size)> StreamReader;
+
+  enum TokenAction { kEmitToken, kSkipToken, kFailToken };
+
+  /**
+   * @brief     Apply the rules to a matched token which is not a comment:
+   *            skip the ignored one and the LF following another LF, then
+   *            intern and decode the lexeme.
+   */
+  TokenAction ProcessToken(LexContext &ctx, Token &token) const;
+
+  /**
+   * @brief     Lex the source text read by the reader, @see LexicalAnalyze()
+   */
+  bool LexStream(const StreamReader &read,
+                 const TokenSink &sink,
+                 size_t buffer_size,
+                 StringInterner *interner) const;
+
+  /**
+   * @brief     Set the value of token to the ID of lexeme, if its symbol is in
+   *            the intern set, or kNotInterned without interner
+   */
+  void Intern(const LexContext &ctx,
+              Token &token,
+              StringInterner *interner) const;
+
+  /**
+   * @brief     Set the value of token to the decoded integer, if its symbol is
+   *            in the integer set
+   * @return    false if the integer is out of the range of int32_t
+   */
+  bool DecodeInteger(const LexContext &ctx, Token &token) const;
+
+  /**
+   * @brief     Skip the body of line comment, including the ending LF
+   * @param ctx the lexing context, current position follows the comment start
+   * @return    whether the ending LF is found before the end
    */
-  bool MatchString(const char *p, const std::string &str);
+  bool SkipLineComment(LexContext &ctx) const;
 
   /**
-   * @param p   current position
-   * @return    skip the liine and block comments
+   * @brief     Skip the body of block comment, scanning each char only once
+   *            by the automaton matching the comment end
+   * @param ctx     the lexing context, current position follows the comment
+   *                start
+   * @param state   the state of automaton, 0 at the comment start. It is kept
+   *                if the comment is not ended, so that the skipping could be
+   *                resumed on the following text.
+   * @return    whether the comment end is found before the end
    */
-  const char *SkipComment(const char *p);
+  bool SkipBlockComment(LexContext &ctx, uint32_t &state) const;
+
+  /**
+   * @brief     Lex until the stop position of context
+   * @param tokens  a std::vector<Token> or TokenBuffer
+   * @param error   output the token failed if not nullptr, which is of
+   *                kErrorSymbol if no token is matched
+   * @return    whether succeed
+   */
+  template<class Tokens>
+  bool LexRange(LexContext &ctx,
+                Tokens &tokens,
+                Token *error = nullptr) const;
 
  private:
   std::shared_ptr<DFA> token_dfa_;
   std::vector<Symbol> priority_to_symbol_;
   std::unordered_set<Symbol> ignore_set_;
+  std::unordered_set<Symbol> intern_set_;
+  std::unordered_set<Symbol> integer_set_;
 
   /**
-   * @brief     comment rules
+   * @brief     The starts of comments are matched by the token DFA, the end of
+   *            block comment is matched by a KMP automaton, whose state is the
+   *            length of matched prefix. The transitions are stored in
+   *            block_end_table_[state * 256 + char].
    */
-  std::string line_comment_start_;
-  std::string block_comment_start_;
   std::string block_comment_end_;
+  std::vector<uint32_t> block_end_table_;
+  byte_scanner::ByteSet block_end_start_;
 
   /**
-   * @brief     position information
+   * @brief     The bytes each of which is an ignored token by itself, skipped
+   *            by the byte scanner instead of the token DFA
    */
-  const char *beg_;
-  const char *end_;
-  const char *curr_;
-  const char *curr_row_pos_;
-  size_t curr_row_;
+  byte_scanner::ByteSet skip_set_;
 };
 
 /**
@@ -113,7 +352,34 @@ class TokenizerBuilder {
    * @param patterns    A set of pairs of regex pattern and symbol
    * @return            this
    */
-  TokenizerBuilder &SetPatterns(const std::vector<TokenPattern> &patterns);
+  TokenizerBuilder &SetPatterns(const std::vector<TokenPattern> &patterns) {
+    patterns_ = patterns;
+    priorities_.assign(patterns.size(), Node::kUnsetInt);
+    base_dfa_.reset();
+    return *this;
+  }
+
+  /**
+   * @brief             Add a pattern after building. The next Build() only
+   *                    compiles this pattern and unions it with the built
+   *                    token DFA, instead of rebuilding the whole one.
+   * @param pattern     A pair of regex pattern and symbol
+   * @param index       The pattern is inserted before the one at the index,
+   *                    the lowest priority by default
+   * @return            this
+   */
+  TokenizerBuilder &AddPattern(const TokenPattern &pattern,
+                               size_t index = SIZE_MAX);
+
+  /**
+   * @brief             Remove the first pattern with the regex. Removing an
+   *                    added pattern only unions the rest added ones with
+   *                    the base token DFA again, while removing others
+   *                    rebuilds the whole token DFA.
+   * @param regex       The regex pattern
+   * @return            whether the pattern is found
+   */
+  bool RemovePattern(const std::string &regex);
 
   /**
    * @param ignore_set  the set of some ignored symbols
@@ -124,36 +390,108 @@ class TokenizerBuilder {
     return *this;
   }
 
+  /**
+   * @param intern_set  the set of symbols whose lexemes are interned, such
+   *                    as identifiers
+   * @return            this
+   */
+  TokenizerBuilder &SetInternSet(std::unordered_set<Symbol> intern_set) {
+    tokenizer_.intern_set_ = std::move(intern_set);
+    return *this;
+  }
+
+  /**
+   * @param integer_set the set of symbols whose lexemes are integer literals
+   *                    in C syntax (decimal, 0x hex or octal), decoded into
+   *                    the value of token. A literal out of the range of
+   *                    int32_t is a lexical error.
+   * @return            this
+   */
+  TokenizerBuilder &SetIntegerSet(std::unordered_set<Symbol> integer_set) {
+    tokenizer_.integer_set_ = std::move(integer_set);
+    return *this;
+  }
+
+  /**
+   * @brief     The start of comment is compiled into the token DFA with the
+   *            highest priority, so the longest match rule is also applied.
+   */
   TokenizerBuilder &SetLineComment(const std::string &line_comment_start) {
-    tokenizer_.line_comment_start_ = line_comment_start;
+    line_comment_start_ = line_comment_start;
+    base_dfa_.reset();
     return *this;
   }
 
   TokenizerBuilder &SetBlockComment(const std::string &block_comment_start,
                                     const std::string &block_comment_end) {
-    tokenizer_.block_comment_start_ = block_comment_start;
+    block_comment_start_ = block_comment_start;
     tokenizer_.block_comment_end_ = block_comment_end;
+    base_dfa_.reset();
     return *this;
   }
 
   /**
-   * @brief     After calling this function, you should not call others.
-   *            Because all the data has been moved.
+   * @brief     Compile the patterns and comment rules into the token DFA.
+   *            The builder keeps the compiled DFAs, so that patterns could be
+   *            added or removed incrementally, then built again.
    */
   Tokenizer Build();
 
  private:
-  void ResetPriority() {
-    priority_index_ = 0;
-  }
+  /**
+   * @brief     Compile all the patterns into the base token DFA
+   */
+  void BuildTokenDFA();
 
-  int NextPriority() {
-    return priority_index_++;
-  }
+  /**
+   * @brief     Union the base token DFA with the DFAs of added patterns,
+   *            compiling the patterns added since last building
+   */
+  void BuildAddedDFAs();
+
+  /**
+   * @brief     Compile the patterns into a minimized DFA
+   * @param first_priority  the priority of the first pattern, the following
+   *                        ones are increased by one
+   * @return    the DFA, or nullptr if failed
+   */
+  std::shared_ptr<DFA> CompileDFA(const std::vector<TokenPattern> &patterns,
+                                  int first_priority);
+
+  /**
+   * @brief     Build the KMP automaton matching the end of block comment
+   */
+  void BuildBlockEndTable();
+
+  /**
+   * @brief     Collect the single-byte ignored tokens from the token DFA
+   */
+  void BuildSkipSet();
 
  private:
   Tokenizer tokenizer_;
-  int priority_index_{0};
+  std::vector<TokenPattern> patterns_;
+  std::string line_comment_start_;
+  std::string block_comment_start_;
+
+  /**
+   * @brief     The priority of each pattern in the token DFA, Node::kUnsetInt
+   *            if it is added but not built. The priorities of base patterns
+   *            are their indices after the comment starts, while an added
+   *            pattern takes a new one, so a priority is only an ID, and the
+   *            order of patterns_ decides which one is higher.
+   */
+  std::vector<int> priorities_;
+  size_t comment_pattern_num_{0};
+
+  /**
+   * @brief     The DFA of all patterns at last full building, and the DFAs of
+   *            patterns added after it, keyed by priority
+   */
+  std::shared_ptr<DFA> base_dfa_;
+  std::vector<std::pair<int, std::shared_ptr<DFA>>> added_dfas_;
+  bool is_added_removed_{false};
+
   bool is_error_{false};
 };
 
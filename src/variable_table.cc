@@ -22,19 +22,20 @@ VariableTable::~VariableTable() {
 }
 
 /**
- * @param key var's name
+ * @param key var's name ID
  * @return  var's value
  * @brief  Get a var from symbol table. Search top level firstly, if not found, search secound level.
  */
-int VariableTable::GetInt(const std::string key) {
+int VariableTable::GetInt(const uint32_t key) {
   int result = 0;
 
   size_t pos = tables.size() - (now_depth + 1);
 
   for (auto iter = tables.rbegin() + pos; iter != tables.rend(); iter++) {
     table_t &table = **iter;
-    if (table.find(key) != table.end()) {
-      result = table[key];
+    auto var = table.find(key);
+    if (var != table.end()) {
+      result = var->second;
       break;
     }
   }
@@ -43,18 +44,19 @@ int VariableTable::GetInt(const std::string key) {
 }
 
 /**
- * @param key var's name
+ * @param key var's name ID
  * @param val var's value
  * @brief  Set a var from symbol table. Search now level firstly, if not found, search lower level.
  *         If can't found it in whole table, then set a new var at the now level
  */
-void VariableTable::SetInt(const std::string key, const int val) {
+void VariableTable::SetInt(const uint32_t key, const int val) {
   size_t pos = tables.size() - (now_depth + 1);
 
   for (auto iter = tables.rbegin() + pos; iter != tables.rend(); iter++) {
     table_t &table = **iter;
-    if (table.find(key) != table.end()) {
-      table[key] = val;
+    auto var = table.find(key);
+    if (var != table.end()) {
+      var->second = val;
       return;
     }
   }
@@ -64,11 +66,11 @@ void VariableTable::SetInt(const std::string key, const int val) {
 }
 
 /**
- * @param key var's name
+ * @param key var's name ID
  * @param val var's value
  * @brief  Define a var from symbol table.
  */
-void VariableTable::NewInt(const std::string key, const int val) {
+void VariableTable::NewInt(const uint32_t key, const int val) {
   table_t &table = *tables[now_depth];
 
   table[key] = val;
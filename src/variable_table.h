@@ -5,6 +5,7 @@
 #ifndef PARSING_TECHNIQUES_SYMBOL_TABLE_H
 #define PARSING_TECHNIQUES_SYMBOL_TABLE_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -18,9 +19,9 @@ class VariableTable {
 
   ~VariableTable();
 
-  int GetInt(const std::string key);
-  void SetInt(const std::string key, const int val);
-  void NewInt(const std::string key, const int val = 0xEEEEEEEE);
+  int GetInt(const uint32_t key);
+  void SetInt(const uint32_t key, const int val);
+  void NewInt(const uint32_t key, const int val = 0xEEEEEEEE);
 
   void PushLevel();
   void PopLevel();
@@ -33,7 +34,8 @@ class VariableTable {
   void Print();
 
  public:
-  typedef std::unordered_map<std::string, int> table_t;
+  // keyed by the interned ID of var's name
+  typedef std::unordered_map<uint32_t, int> table_t;
 
  private:
   std::vector<table_t *> tables;
@@ -0,0 +1,381 @@
+//
+// Created by Dyinnz on 16-11-09.
+//
+
+/**
+ * The throughput benchmark of tokenizer.
+ *
+ * Synthetic c-like corpora are generated from the min size to the max size,
+ * growing by 32 times. The mix of lexemes could be configured by weights.
+ *
+ * Usage:
+ *   bench_tokenizer [--min-size=1K] [--max-size=32M] [--seed=2016]
+ *                   [--mix=identifier:30,number:15,string:5,comment:10,space:40]
+ *
+ * The size accepts the suffixes K, M and G, up to 1G. Build it with
+ * -DCMAKE_BUILD_TYPE=Release to get meaningful numbers.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simplelogger.h"
+#include "clike_grammar.h"
+
+using namespace std;
+using namespace simple_logger;
+
+BaseLogger logger;
+
+/**
+ * Count all the allocations by replacing the global operator new
+ */
+static atomic<size_t> g_alloc_count{0};
+
+void *operator new(size_t size) {
+  g_alloc_count.fetch_add(1, memory_order_relaxed);
+  if (void *p = malloc(size ? size : 1)) {
+    return p;
+  }
+  throw bad_alloc();
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+constexpr size_t kKB = 1024;
+constexpr size_t kMB = 1024 * kKB;
+constexpr size_t kGB = 1024 * kMB;
+
+/**
+ * @brief   Each size of corpus is measured for at least this seconds
+ */
+constexpr double kMinMeasureSeconds = 0.5;
+
+enum LexemeKind {
+  kIdentifierKind,
+  kNumberKind,
+  kStringKind,
+  kCommentKind,
+  kSpaceKind,
+  kKindCount,
+};
+
+const char *kKindNames[kKindCount] = {
+    "identifier", "number", "string", "comment", "space",
+};
+
+struct BenchConfig {
+  size_t min_size{kKB};
+  size_t max_size{32 * kMB};
+  unsigned seed{2016};
+  double mix[kKindCount]{30, 15, 5, 10, 40};
+};
+
+double SecondsSince(Clock::time_point start) {
+  return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @return    the size in bytes, or 0 if the text is invalid
+ */
+size_t ParseSize(const char *s) {
+  char *suffix = nullptr;
+  size_t size = strtoull(s, &suffix, 10);
+  switch (*suffix) {
+    case '\0': return size;
+    case 'k': case 'K': return size * kKB;
+    case 'm': case 'M': return size * kMB;
+    case 'g': case 'G': return size * kGB;
+    default: return 0;
+  }
+}
+
+/**
+ * @param s   such as "identifier:30,number:15"
+ */
+bool ParseMix(const char *s, BenchConfig &config) {
+  fill(begin(config.mix), end(config.mix), 0.0);
+  string text(s);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t comma = text.find(',', pos);
+    if (string::npos == comma) {
+      comma = text.size();
+    }
+    string item = text.substr(pos, comma - pos);
+    size_t colon = item.find(':');
+    if (string::npos == colon) {
+      return false;
+    }
+
+    string name = item.substr(0, colon);
+    int kind = 0;
+    while (kind < kKindCount && name != kKindNames[kind]) {
+      kind += 1;
+    }
+    if (kKindCount == kind) {
+      return false;
+    }
+    config.mix[kind] = atof(item.c_str() + colon + 1);
+    pos = comma + 1;
+  }
+
+  for (double weight : config.mix) {
+    if (weight > 0.0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseArgs(int argc, char *argv[], BenchConfig &config) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (0 == strncmp(arg, "--min-size=", 11)) {
+      config.min_size = ParseSize(arg + 11);
+    } else if (0 == strncmp(arg, "--max-size=", 11)) {
+      config.max_size = ParseSize(arg + 11);
+    } else if (0 == strncmp(arg, "--seed=", 7)) {
+      config.seed = static_cast<unsigned>(atoi(arg + 7));
+    } else if (0 == strncmp(arg, "--mix=", 6)) {
+      if (!ParseMix(arg + 6, config)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+
+  return 0 != config.min_size
+      && config.min_size <= config.max_size
+      && config.max_size <= kGB;
+}
+
+/**
+ * @brief   Generate the c-like source text. Every lexeme is followed by a
+ *          space or an operator, so that the adjacent ones are not merged.
+ */
+class CorpusGenerator {
+ public:
+  explicit CorpusGenerator(const BenchConfig &config)
+      : engine_(config.seed),
+        kind_dist_(begin(config.mix), end(config.mix)) {}
+
+  string Generate(size_t size) {
+    string s;
+    s.reserve(size + kMaxLexemeSize);
+    while (s.size() < size) {
+      switch (kind_dist_(engine_)) {
+        case kIdentifierKind: AppendIdentifier(s); break;
+        case kNumberKind: AppendNumber(s); break;
+        case kStringKind: AppendString(s); break;
+        case kCommentKind: AppendComment(s); break;
+        default: AppendSpace(s); break;
+      }
+      AppendSeparator(s);
+    }
+    return s;
+  }
+
+ private:
+  static constexpr size_t kMaxLexemeSize = 128;
+
+  size_t Random(size_t n) {
+    return uniform_int_distribution<size_t>(0, n - 1)(engine_);
+  }
+
+  void AppendWord(string &s, size_t max_length) {
+    static const char kLetters[] = "abcdefghijklmnopqrstuvwxyz"
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+    size_t length = 1 + Random(max_length);
+    for (size_t i = 0; i < length; ++i) {
+      s += kLetters[Random(sizeof(kLetters) - 1)];
+    }
+  }
+
+  void AppendIdentifier(string &s) {
+    AppendWord(s, 12);
+    if (0 == Random(4)) {
+      s += to_string(Random(100));
+    }
+  }
+
+  void AppendNumber(string &s) {
+    if (0 == Random(8)) {
+      char hex[16];
+      snprintf(hex, sizeof(hex), "0x%zx", Random(1 << 20));
+      s += hex;
+    } else {
+      s += to_string(Random(1000000));
+    }
+  }
+
+  void AppendString(string &s) {
+    s += '"';
+    for (size_t i = 1 + Random(6); i > 0; --i) {
+      AppendWord(s, 8);
+      s += ' ';
+    }
+    s += '"';
+  }
+
+  void AppendComment(string &s) {
+    bool is_line = 0 == Random(2);
+    s += is_line ? "//" : "/*";
+    for (size_t i = 1 + Random(8); i > 0; --i) {
+      s += ' ';
+      AppendWord(s, 8);
+    }
+    s += is_line ? "\r\n" : " */";
+  }
+
+  void AppendSpace(string &s) {
+    if (0 == Random(3)) {
+      s += "\r\n";
+    }
+    s.append(Random(8), Random(4) ? ' ' : '\t');
+  }
+
+  void AppendSeparator(string &s) {
+    static const char kSeparators[] = " ;,=+-*<>(){}";
+    s += kSeparators[Random(sizeof(kSeparators) - 1)];
+  }
+
+ private:
+  mt19937 engine_;
+  discrete_distribution<int> kind_dist_;
+};
+
+string FormatSize(size_t size) {
+  char buf[32];
+  if (size >= kGB && 0 == size % kGB) {
+    snprintf(buf, sizeof(buf), "%zuG", size / kGB);
+  } else if (size >= kMB && 0 == size % kMB) {
+    snprintf(buf, sizeof(buf), "%zuM", size / kMB);
+  } else if (size >= kKB && 0 == size % kKB) {
+    snprintf(buf, sizeof(buf), "%zuK", size / kKB);
+  } else {
+    snprintf(buf, sizeof(buf), "%zuB", size);
+  }
+  return buf;
+}
+
+void BenchBuild() {
+  constexpr int kRounds = 5;
+  double seconds = 0.0;
+  size_t allocs = 0;
+  for (int i = 0; i < kRounds; ++i) {
+    size_t alloc_start = g_alloc_count.load();
+    auto start = Clock::now();
+    Tokenizer tokenizer = clike_grammar::BuilderClikeTokenizer();
+    seconds += SecondsSince(start);
+    allocs += g_alloc_count.load() - alloc_start;
+  }
+
+  printf("BuilderClikeTokenizer: %.3f ms, %zu allocs per build\n\n",
+         seconds / kRounds * 1000.0, allocs / kRounds);
+}
+
+/**
+ * @brief   Lex the corpus repeatly, each time into a new container, so that
+ *          the allocations of growing it are counted
+ */
+template<class Tokens>
+void BenchLex(const Tokenizer &tokenizer,
+              const char *name,
+              size_t size,
+              const string &corpus) {
+  size_t rounds = 0;
+  size_t token_count = 0;
+  size_t allocs = 0;
+  double seconds = 0.0;
+
+  do {
+    Tokens tokens;
+    StringInterner interner;
+    size_t alloc_start = g_alloc_count.load();
+    auto start = Clock::now();
+    bool is_ok = tokenizer.LexicalAnalyze(corpus.data(),
+                                          corpus.data() + corpus.size(),
+                                          tokens,
+                                          &interner);
+    seconds += SecondsSince(start);
+    allocs += g_alloc_count.load() - alloc_start;
+    if (!is_ok) {
+      fprintf(stderr, "failed to lex the corpus\n");
+      exit(-1);
+    }
+    token_count += tokens.size();
+    rounds += 1;
+  } while (seconds < kMinMeasureSeconds);
+
+  double mb = static_cast<double>(corpus.size()) * rounds / kMB;
+  printf("%8s %-12s %10.2f %14.0f %14.4f %8zu\n",
+         FormatSize(size).c_str(),
+         name,
+         mb / seconds,
+         token_count / seconds,
+         static_cast<double>(allocs) / token_count,
+         rounds);
+}
+
+} // end of namespace
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  if (!ParseArgs(argc, argv, config)) {
+    fprintf(stderr,
+            "usage: %s [--min-size=1K] [--max-size=32M] [--seed=2016]\n"
+            "       [--mix=identifier:30,number:15,string:5,comment:10,"
+            "space:40]\n"
+            "the max size is 1G\n",
+            argv[0]);
+    return -1;
+  }
+
+#ifndef __OPTIMIZE__
+  printf("WARNING: the benchmark is built without optimization\n\n");
+#endif
+
+  printf("mix:");
+  for (int kind = 0; kind < kKindCount; ++kind) {
+    printf(" %s:%g", kKindNames[kind], config.mix[kind]);
+  }
+  printf("\n");
+
+  BenchBuild();
+  Tokenizer tokenizer = clike_grammar::BuilderClikeTokenizer();
+
+  printf("%8s %-12s %10s %14s %14s %8s\n",
+         "size", "container", "MB/s", "tokens/s", "allocs/token", "rounds");
+
+  CorpusGenerator generator(config);
+  for (size_t size = config.min_size; size <= config.max_size; size *= 32) {
+    string corpus = generator.Generate(size);
+    BenchLex<vector<Token>>(tokenizer, "vector", size, corpus);
+    BenchLex<TokenBuffer>(tokenizer, "TokenBuffer", size, corpus);
+  }
+
+  return 0;
+}
@@ -0,0 +1,70 @@
+//
+// Created by Dyinnz on 16-11-04.
+//
+
+
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+#include <string>
+#include "byte_scanner.h"
+
+using std::string;
+using namespace byte_scanner;
+
+TEST_CASE("Skip and find bytes", "[Byte Scanner]") {
+  ByteSet spaces;
+  REQUIRE(spaces.Insert(' '));
+  REQUIRE(spaces.Insert('\t'));
+  REQUIRE(spaces.Insert('\n'));
+
+  // every length and position crosses the blocks of SIMD
+  for (size_t prefix = 0; prefix < 80; ++prefix) {
+    string s;
+    size_t lf_count = 0;
+    size_t last_lf = 0;
+    for (size_t i = 0; i < prefix; ++i) {
+      char c = " \t\n"[i % 3];
+      if ('\n' == c) {
+        lf_count += 1;
+        last_lf = i;
+      }
+      s += c;
+    }
+    s += "x \n*";
+
+    LineCounter counter;
+    const char *p = SkipBytes(s.c_str(), s.c_str() + s.size(), spaces, counter);
+    REQUIRE(p == s.c_str() + prefix);
+    REQUIRE(lf_count == counter.lf_count);
+    if (lf_count) {
+      REQUIRE(counter.last_lf == s.c_str() + last_lf);
+    }
+
+    ByteSet stars;
+    stars.Insert('*');
+    counter = LineCounter();
+    p = FindBytes(s.c_str(), s.c_str() + s.size(), stars, counter);
+    REQUIRE(p == s.c_str() + s.size() - 1);
+    REQUIRE(lf_count + 1 == counter.lf_count);
+    REQUIRE(counter.last_lf == p - 1);
+
+    // not found
+    counter = LineCounter();
+    p = FindBytes(s.c_str(), s.c_str() + prefix, stars, counter);
+    REQUIRE(p == s.c_str() + prefix);
+  }
+}
+
+TEST_CASE("Byte set is small", "[Byte Scanner]") {
+  const size_t max_size = ByteSet::kMaxSize;
+  ByteSet set;
+  for (size_t i = 0; i < max_size; ++i) {
+    REQUIRE(set.Insert(static_cast<char>('a' + i)));
+  }
+  REQUIRE(set.Insert('a'));
+  REQUIRE_FALSE(set.Insert('z'));
+  REQUIRE(max_size == set.size());
+  REQUIRE(set.Contains('c'));
+  REQUIRE_FALSE(set.Contains('z'));
+}
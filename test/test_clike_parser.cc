@@ -9,6 +9,8 @@
 #include "test_utility.h"
 #include "clike_grammar.h"
 #include "clike_parser.h"
+#include "flat_ast.h"
+#include "ast_cache.h"
 
 using namespace simple_logger;
 BaseLogger logger;
@@ -16,15 +18,21 @@ BaseLogger logger;
 using std::string;
 using std::vector;
 
-vector<Token> GetTokensFromFile(const string &filename) {
+/**
+ * The tokens refer to the source, so the source is kept by caller
+ */
+vector<Token> GetTokensFromFile(const string &filename, string &source) {
   GET_FILE_DATA_SAFELY(data, size, filename)
+  if (data) {
+    source.assign(data, size);
+  }
   auto tokenizer = clike_grammar::BuilderClikeTokenizer();
   vector<Token> tokens;
-  auto result = tokenizer.LexicalAnalyze(data, data + size, tokens);
+  auto result = tokenizer.LexicalAnalyze(source, tokens);
   REQUIRE(result);
 
   for (auto &t : tokens) {
-    logger.debug("{}", to_string(t));
+    logger.debug("{}", to_string(t, source.c_str()));
   }
 
   return tokens;
@@ -33,31 +41,590 @@ vector<Token> GetTokensFromFile(const string &filename) {
 TEST_CASE("Empty") {
   logger.set_log_level(kDebug);
 
-  auto tokens = GetTokensFromFile("test/data/dy-test-1.c");
+  string source;
+  auto tokens = GetTokensFromFile("test/data/dy-test-1.c", source);
   REQUIRE(0 == tokens.size());
 
   ClikeParser parser;
-  parser.Parse(tokens);
+  parser.Parse(tokens, source.c_str());
 }
 
 TEST_CASE("Comments") {
-  auto tokens = GetTokensFromFile("test/data/dy-test-2.c");
+  string source;
+  auto tokens = GetTokensFromFile("test/data/dy-test-2.c", source);
   REQUIRE(0 == tokens.size());
 
   ClikeParser parser;
-  parser.Parse(tokens);
+  parser.Parse(tokens, source.c_str());
 }
 
 TEST_CASE("Declaration & Definition") {
-  auto tokens = GetTokensFromFile("test/data/dy-test-3.c");
+  string source;
+  auto tokens = GetTokensFromFile("test/data/dy-test-3.c", source);
 
   ClikeParser parser;
-  parser.Parse(tokens);
+  parser.Parse(tokens, source.c_str());
 }
 
 TEST_CASE("if & else") {
-  auto tokens = GetTokensFromFile("test/data/dy-test-4.c");
+  string source;
+  auto tokens = GetTokensFromFile("test/data/dy-test-4.c", source);
+
+  ClikeParser parser;
+  parser.Parse(tokens, source.c_str());
+}
+
+TEST_CASE("Dense index and sets of symbols") {
+  using namespace clike_grammar;
+  static_assert(kExprFirst.Contains(kPrintfID), "built at compile time");
+
+  // the indices are distinct, and 0 is not a symbol
+  vector<Symbol> symbols = ClikeSymbols();
+  symbols.insert(symbols.end(), {kEofSymbol, kLFSymbol, kBlockCommentSymbol});
+  vector<bool> is_used(kSymbolIndexNum);
+  for (auto &symbol : symbols) {
+    REQUIRE(0 < symbol.Index());
+    REQUIRE(symbol.Index() < kSymbolIndexNum);
+    REQUIRE_FALSE(is_used[symbol.Index()]);
+    is_used[symbol.Index()] = true;
+  }
+  REQUIRE(0 == SymbolIndex(kStartID + kSymbolIndexNum));
+
+  for (auto &symbol : symbols) {
+    bool is_first = kAdd == symbol || kSub == symbol || kLeftParen == symbol
+        || kPrintf == symbol || kIdentifier == symbol || kNumber == symbol;
+    REQUIRE(is_first == kExprFirst.Contains(symbol));
+  }
+  auto set = kBlockBodyFollow | SymbolSet(kElseID);
+  REQUIRE(set.Contains(kEofSymbol));
+  REQUIRE(set.Contains(kElse));
+  REQUIRE_FALSE(set.Contains(kErrorSymbol));
+}
+
+TEST_CASE("Node text refers to source") {
+  string source("int abc = 10;\r\n\r\nabc = 20;\r\n");
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+  REQUIRE(9 == tokens.size());
+  REQUIRE(4 == tokens[1].offset);
+  REQUIRE(3 == tokens[1].length);
+
+  ClikeParser parser;
+  auto ast = parser.Parse(tokens, source.c_str());
+  REQUIRE(ast.source() == source.c_str());
+
+  auto decl = ast.root()->children().front();
+  REQUIRE("int" == decl->text());
+  auto assign = decl->children().front();
+  REQUIRE("=" == assign->text());
+  REQUIRE("abc" == assign->children().front()->text());
+  REQUIRE("10" == assign->children().back()->text());
+  REQUIRE(ast.root()->text().empty());
+
+  REQUIRE(1 == ast.row(assign));
+  REQUIRE(8 == ast.column(assign));
+  auto second = ast.root()->children().back();
+  REQUIRE("=" == second->text());
+  REQUIRE(3 == ast.row(second));
+  REQUIRE(4 == ast.column(second));
+  REQUIRE(SIZE_MAX == ast.row(ast.root()));
+}
+
+static bool IsSameTree(AstNode *lhs, AstNode *rhs) {
+  if (!lhs || !rhs) {
+    return lhs == rhs;
+  }
+  if (lhs->symbol() != rhs->symbol() || lhs->text() != rhs->text()
+      || lhs->position() != rhs->position()
+      || lhs->children().size() != rhs->children().size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs->children().size(); ++i) {
+    if (!IsSameTree(lhs->children()[i], rhs->children()[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("Parse from token stream") {
+  string source;
+  auto tokens = GetTokensFromFile("test/input/dy-test-4.c", source);
+  REQUIRE(0 < tokens.size());
+
+  ClikeParser vector_parser;
+  auto vector_ast = vector_parser.Parse(tokens, source.c_str());
+
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  TokenStream stream(tokenizer, source.c_str(),
+                     source.c_str() + source.size());
+  ClikeParser stream_parser;
+  auto stream_ast = stream_parser.Parse(stream);
+  REQUIRE_FALSE(stream.IsError());
+
+  REQUIRE(IsSameTree(vector_ast.root(), stream_ast.root()));
+
+  TokenBuffer buffer;
+  REQUIRE(tokenizer.LexicalAnalyze(source.c_str(),
+                                   source.c_str() + source.size(),
+                                   buffer));
+  ClikeParser buffer_parser;
+  auto buffer_ast = buffer_parser.Parse(buffer, source.c_str());
+  REQUIRE(IsSameTree(vector_ast.root(), buffer_ast.root()));
+}
+
+TEST_CASE("Parse top-level statements in parallel") {
+  string source("int a = 0, i;\r\n");
+  for (int i = 0; i < 100; ++i) {
+    source += "for (i = 0; i < 2; i = i + 1) { a = a + i; }\r\n"
+              "if (a > 9) a = 0; else if (a) { a = 1; }\r\n"
+              "if (a) a = a - 1;\r\n"
+              "do { a = a + 2; } while (a < 3);\r\n"
+              "while (a < 7) a = a + 1;\r\n";
+  }
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+
+  ClikeParser parser;
+  auto expect = parser.Parse(tokens, source.c_str());
+  REQUIRE(expect.IsComplete());
+  for (size_t thread_num = 2; thread_num <= 8; thread_num *= 2) {
+    auto ast = parser.ParseParallel(tokens, source.c_str(), thread_num, 1);
+    REQUIRE(IsSameTree(expect.root(), ast.root()));
+    REQUIRE(ast.IsComplete());
+  }
+
+  // the slices from the syntax error are parsed serially
+  source.replace(source.rfind("a = 0;"), 6, "a = ;");
+  tokens.clear();
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+  expect = parser.Parse(tokens, source.c_str());
+  auto ast = parser.ParseParallel(tokens, source.c_str(), 4, 1);
+  REQUIRE(IsSameTree(expect.root(), ast.root()));
+  REQUIRE_FALSE(ast.IsComplete());
+}
+
+TEST_CASE("Reparse the statements affected by an edit") {
+  string source("int a = 1;\r\n"
+                "while (a < 9) {\r\n"
+                "  a = a + 1;\r\n"
+                "  if (a) a = 2;\r\n"
+                "  a = 3;\r\n"
+                "  a = 4;\r\n"
+                "  a = 5;\r\n"
+                "}\r\n"
+                "printf(\"%d\", a);\r\n");
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+  ClikeParser parser;
+  auto ast = parser.Parse(tokens, source.c_str());
+
+  // the result is always the same as parsing from scratch
+  auto edit = [&](const string &from, const string &to) {
+    auto offset = static_cast<uint32_t>(source.find(from));
+    REQUIRE(tokenizer.Relex(source, tokens, offset, from.size(), to));
+    bool is_spliced = parser.Reparse(ast, tokens, source.c_str(), offset,
+                                     from.size(), to.size());
+    ClikeParser full_parser;
+    auto expect = full_parser.Parse(tokens, source.c_str());
+    REQUIRE(IsSameTree(expect.root(), ast.root()));
+    return is_spliced;
+  };
+
+  // only the statement in the block is parsed again
+  auto while_node = ast.root()->children()[1];
+  auto printf_node = ast.root()->children()[2];
+  REQUIRE(edit("a + 1", "a * 2 + 1"));
+  REQUIRE(while_node == ast.root()->children()[1]);
+  REQUIRE(printf_node == ast.root()->children()[2]);
+  REQUIRE(5 == while_node->children().back()->children().size());
+
+  // the else is attached to the if before the edit
+  REQUIRE(edit("a = 3;", "else a = 3;"));
+  REQUIRE(4 == while_node->children().back()->children().size());
+
+  // the } is edited, so that the outer block is parsed again
+  REQUIRE(edit("a = 5;\r\n}", "}\r\na = 5;"));
+  REQUIRE(4 == ast.root()->children().size());
+  REQUIRE(9 == ast.row(ast.root()->children()[3]));
+
+  // then the ast with syntax errors is parsed as a whole
+  REQUIRE(edit("a = 4;", "a = ;"));
+  REQUIRE_FALSE(ast.IsComplete());
+  REQUIRE_FALSE(edit("a = ;", "a = 4;"));
+  REQUIRE(ast.IsComplete());
+}
+
+TEST_CASE("Recover from syntax errors") {
+  string source("int a = 1;\r\n"
+                "a = ;\r\n"
+                "while (a b) { a = 1; }\r\n"
+                "a = a + 1;\r\n"
+                "if (a) a = (a; else a = 2;\r\n"
+                "}\r\n"
+                "int b c;\r\n"
+                "printf(\"%d\", a);\r\n");
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+  ClikeParser parser;
+  auto ast = parser.Parse(tokens, source.c_str());
+  REQUIRE_FALSE(parser.IsError());
+  REQUIRE_FALSE(ast.IsComplete());
+
+  // all the errors are collected by one pass
+  auto &diagnostics = parser.diagnostics();
+  REQUIRE(5 == diagnostics.size());
+  REQUIRE(2 == diagnostics[0].row);
+  REQUIRE(4 == diagnostics[0].column);
+  REQUIRE("expect a number or identifier" == diagnostics[0].message);
+  REQUIRE(3 == diagnostics[1].row);
+  REQUIRE(9 == diagnostics[1].column);
+  REQUIRE("expect a )" == diagnostics[1].message);
+  REQUIRE(5 == diagnostics[2].row);
+  REQUIRE(13 == diagnostics[2].column);
+  REQUIRE(6 == diagnostics[3].row);
+  REQUIRE("unexpected right-brace" == diagnostics[3].message);
+  REQUIRE(7 == diagnostics[4].row);
+  REQUIRE(source.find("c;") == diagnostics[4].offset);
+
+  // the statements after the errors are kept, and there is no null child
+  auto stmts = ast.root()->children();
+  REQUIRE(8 == stmts.size());
+  REQUIRE(kErrorSymbol == stmts[2]->symbol());
+  REQUIRE("a" == stmts[3]->children().front()->text());
+  REQUIRE(clike_grammar::kIfRoot == stmts[4]->symbol());
+  REQUIRE(2 == stmts[4]->children().size());
+  REQUIRE(kErrorSymbol == stmts[6]->symbol());
+  REQUIRE("printf" == stmts[7]->text());
+
+  size_t error_num = 0;
+  vector<AstNode *> stack{ast.root()};
+  while (!stack.empty()) {
+    auto node = stack.back();
+    stack.pop_back();
+    REQUIRE(node);
+    error_num += kErrorSymbol == node->symbol();
+    stack.insert(stack.end(), node->children().begin(),
+                 node->children().end());
+  }
+  REQUIRE(5 == error_num);
+
+  // the same in parallel
+  auto parallel = parser.ParseParallel(tokens, source.c_str(), 4, 1);
+  REQUIRE(IsSameTree(ast.root(), parallel.root()));
+  REQUIRE(5 == parser.diagnostics().size());
 
+  // the error at the end is reported after the last token
+  string unclosed("int a = 1;\r\n"
+                  "while (a) {\r\n"
+                  "  a = 0;\r\n");
+  tokens.clear();
+  REQUIRE(tokenizer.LexicalAnalyze(unclosed, tokens));
+  parser.Parse(tokens, unclosed.c_str());
+  REQUIRE(1 == parser.diagnostics().size());
+  REQUIRE("expect right-brace" == parser.diagnostics()[0].message);
+  REQUIRE(3 == parser.diagnostics()[0].row);
+  REQUIRE(8 == parser.diagnostics()[0].column);
+
+  TokenBuffer buffer;
+  REQUIRE(tokenizer.LexicalAnalyze(unclosed.c_str(),
+                                   unclosed.c_str() + unclosed.size(),
+                                   buffer));
+  parser.Parse(buffer, unclosed.c_str());
+  REQUIRE(1 == parser.diagnostics().size());
+  REQUIRE(3 == parser.diagnostics()[0].row);
+}
+
+static bool IsSameTree(AstNode *lhs, const FlatAst &flat, uint32_t rhs) {
+  const FlatNode &node = flat.node(rhs);
+  if (lhs->symbol() != flat.symbol(rhs) || lhs->text() != flat.text(rhs)
+      || lhs->length() != node.length
+      || lhs->children().size() != node.child_num) {
+    return false;
+  }
+  if (lhs->position()) {
+    if (lhs->position() - flat.source() != node.offset) {
+      return false;
+    }
+  } else if (FlatAst::kNoOffset != node.offset) {
+    return false;
+  }
+  for (uint32_t i = 0; i < node.child_num; ++i) {
+    if (!IsSameTree(lhs->children()[i], flat, flat.child(rhs, i))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST_CASE("Convert to flat ast") {
+  string source;
+  auto tokens = GetTokensFromFile("test/input/dy-test-4.c", source);
+  ClikeParser parser;
+  auto ast = parser.Parse(tokens, source.c_str());
+  FlatAst flat(ast);
+  REQUIRE(0 == flat.root());
+  REQUIRE(IsSameTree(ast.root(), flat, flat.root()));
+
+  // the children are contiguous, and stored after their parent
+  size_t visited = 0;
+  int max_depth = 0;
+  flat.Walk(flat.root(), [&](uint32_t index, int depth) {
+    visited += 1;
+    max_depth = std::max(max_depth, depth);
+    auto children = flat.children(index);
+    REQUIRE((children.empty() || children.front() > index));
+    return true;
+  });
+  REQUIRE(flat.size() == visited);
+  REQUIRE(0 < max_depth);
+
+  // the visitor could prune the sub trees
+  visited = 0;
+  flat.Walk(flat.root(), [&](uint32_t, int depth) {
+    visited += 1;
+    return 0 == depth;
+  });
+  REQUIRE(1 + flat.child_num(flat.root()) == visited);
+
+  FlatAst empty((Ast()));
+  REQUIRE(FlatAst::kNullIndex == empty.root());
+}
+
+TEST_CASE("Hash-cons the identical expressions") {
+  string source("int a = 1, b = 2, c;\r\n"
+                "c = a * b + 1;\r\n"
+                "c = a * b + 1;\r\n"
+                "c = a * b\r\n"
+                "  + 1;\r\n"
+                "c = a * b + 2;\r\n"
+                "printf(\"%d\", a * b);\r\n");
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+  ClikeParser parser;
+  auto expect = parser.Parse(tokens, source.c_str());
+  parser.set_hash_consing(true);
+  auto ast = parser.Parse(tokens, source.c_str());
+  REQUIRE(ast.IsHashConsed());
+
+  // the nodes of use sites are kept, with their own rows
+  auto rhs = [&ast](size_t i) {
+    return ast.root()->children()[i]->children().back();
+  };
+  REQUIRE_FALSE(rhs(1)->IsSharingChildren());
+  REQUIRE(rhs(2)->IsSharingChildren());
+  REQUIRE(rhs(1)->children()[0] == rhs(2)->children()[0]);
+  REQUIRE(3 == ast.row(rhs(2)));
+
+  // the expression in multiple lines keeps its children
+  REQUIRE_FALSE(rhs(3)->IsSharingChildren());
+  REQUIRE(rhs(4)->children()[0]->IsSharingChildren());
+  auto printf_node = ast.root()->children().back();
+  REQUIRE(printf_node->children().back()->IsSharingChildren());
+
+  // the shared children are stored once in the flat ast
+  FlatAst flat(ast);
+  FlatAst expect_flat(expect);
+  REQUIRE(IsSameTree(ast.root(), flat, flat.root()));
+  REQUIRE(flat.size() < expect_flat.size());
+
+  // a hash-consed ast is parsed again as a whole
+  string from("a * b + 2");
+  auto offset = static_cast<uint32_t>(source.find(from));
+  REQUIRE(tokenizer.Relex(source, tokens, offset, from.size(), "a * b + 1"));
+  REQUIRE_FALSE(parser.Reparse(ast, tokens, source.c_str(), offset,
+                               from.size(), from.size()));
+  REQUIRE(rhs(5)->IsSharingChildren());
+}
+
+TEST_CASE("Save and load flat ast by cache") {
+  string source;
+  GET_FILE_DATA_SAFELY(data, size, "test/input/dy-test-4.c")
+  source.assign(data, size);
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  StringInterner interner;
+  TokenStream stream(tokenizer, source.c_str(),
+                     source.c_str() + source.size(), &interner);
+  ClikeParser parser;
+  auto ast = parser.Parse(stream);
+  FlatAst flat(ast);
+
+  char dir_template[] = "/tmp/test_ast_cache.XXXXXX";
+  REQUIRE(nullptr != mkdtemp(dir_template));
+  string dir = dir_template;
+  AstCache cache(dir + "/cache", clike_grammar::ClikeSymbols());
+
+  FlatAst loaded;
+  StringInterner loaded_interner;
+  REQUIRE_FALSE(cache.Load(source.c_str(), source.size(), loaded));
+  REQUIRE(cache.Save(source.c_str(), source.size(), flat, &interner));
+  REQUIRE(cache.Load(source.c_str(), source.size(), loaded,
+                     &loaded_interner));
+
+  REQUIRE(flat.size() == loaded.size());
+  REQUIRE(IsSameTree(ast.root(), loaded, loaded.root()));
+  for (uint32_t i = 0; i < flat.size(); ++i) {
+    REQUIRE(flat.value(i) == loaded.value(i));
+    REQUIRE(flat.row(i) == loaded.row(i));
+  }
+  REQUIRE(interner.size() == loaded_interner.size());
+  for (uint32_t id = 0; id < interner.size(); ++id) {
+    REQUIRE(interner.str(id) == loaded_interner.str(id));
+  }
+
+  // a changed source misses the cache
+  string changed = source + " ";
+  REQUIRE_FALSE(cache.Load(changed.c_str(), changed.size(), loaded));
+
+  // a source colliding with the hash and size misses the cache
+  string collided = source;
+  collided.back() ^= 1;
+  uint64_t collided_hash = AstCache::HashSource(collided.c_str(),
+                                                collided.size());
+  string collided_path = cache.PathOf(collided_hash);
+  {
+    std::ifstream in(cache.PathOf(AstCache::HashSource(source.c_str(),
+                                                       source.size())),
+                     std::ios::binary);
+    string file((std::istreambuf_iterator<char>(in)),
+                std::istreambuf_iterator<char>());
+    // the hash follows the magic, version and node size in header
+    memcpy(&file[16], &collided_hash, sizeof(collided_hash));
+    std::ofstream out(collided_path, std::ios::binary);
+    out << file;
+  }
+  REQUIRE_FALSE(cache.Load(collided.c_str(), collided.size(), loaded));
+  remove(collided_path.c_str());
+
+  // the tree with syntax errors is not saved
+  string broken = "int a;\r\na = ;\r\n";
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(broken, tokens));
+  auto broken_ast = parser.Parse(tokens, broken.c_str());
+  REQUIRE_FALSE(FlatAst(broken_ast).IsComplete());
+  REQUIRE_FALSE(cache.Save(broken.c_str(), broken.size(),
+                           FlatAst(broken_ast)));
+
+  // the interner is untouched if the names are rejected partway
+  string path = cache.PathOf(AstCache::HashSource(source.c_str(),
+                                                  source.size()));
+  {
+    std::ifstream in(path, std::ios::binary);
+    string file((std::istreambuf_iterator<char>(in)),
+                std::istreambuf_iterator<char>());
+    // the counts follow the hash and size in header, and the sections are
+    // aligned to 8 bytes
+    uint32_t counts[4];
+    memcpy(counts, &file[32], sizeof(counts));
+    auto align = [](size_t size) { return (size + 7) & ~size_t(7); };
+    size_t pos = 56 + align(counts[0] * sizeof(FlatNode)) + align(counts[1] * 8)
+        + align(counts[2] * 4);
+    const uint32_t name_num = counts[3];
+    REQUIRE(3 <= name_num);
+    // the second last name ends before it begins
+    memset(&file[pos + (name_num - 1) * 4], 0, 4);
+    std::ofstream out(path, std::ios::binary);
+    out << file;
+  }
+  StringInterner rejected_interner;
+  REQUIRE_FALSE(cache.Load(source.c_str(), source.size(), loaded,
+                           &rejected_interner));
+  REQUIRE(0 == rejected_interner.size());
+
+  // a corrupted file is rejected
+  REQUIRE(0 == truncate(path.c_str(), 64));
+  REQUIRE_FALSE(cache.Load(source.c_str(), source.size(), loaded));
+
+  remove(path.c_str());
+  rmdir((dir + "/cache").c_str());
+  rmdir(dir.c_str());
+}
+
+/**
+ * @brief   Print the expression as (op lhs rhs)
+ */
+static string ToSExpr(AstNode *node) {
+  if (!node) {
+    return "null";
+  }
+  if (node->children().empty()) {
+    return node->text();
+  }
+  string s = "(" + node->text();
+  for (auto child : node->children()) {
+    s += " " + ToSExpr(child);
+  }
+  return s + ")";
+}
+
+TEST_CASE("Precedence and associativity of expressions") {
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+  auto parse_expr = [&](const string &source) {
+    vector<Token> tokens;
+    REQUIRE(tokenizer.LexicalAnalyze(source, tokens));
+    ClikeParser parser;
+    auto ast = parser.Parse(tokens, source.c_str());
+    REQUIRE(1 == ast.root()->children().size());
+    return ToSExpr(ast.root()->children().front());
+  };
+
+  REQUIRE("(, (= a (= b (+ c (* d (- (++ e)))))) f)"
+              == parse_expr("a = b = c + d * -e++, f;"));
+  REQUIRE("(== a (< b (- c (/ d e))))" == parse_expr("a == b < c - d / e;"));
+  REQUIRE("(- (- a b) c)" == parse_expr("a - b - c;"));
+  REQUIRE("(, (, a b) c)" == parse_expr("a, b, c;"));
+  REQUIRE("(* (, a b) c)" == parse_expr("(a, b) * c;"));
+  REQUIRE("(= (== a b) c)" == parse_expr("a == b = c;"));
+  REQUIRE("(int (= a (= b 1)) c)" == parse_expr("int a = b = 1, c;"));
+}
+
+TEST_CASE("Parse deep nesting without recursion") {
+  constexpr size_t kDepth = 100000;
+  auto tokenizer = clike_grammar::BuilderClikeTokenizer();
+
+  // far deeper than the native stack allows for recursion
+  string parens = "a = " + string(kDepth, '(') + "b" + string(kDepth, ')')
+      + ";";
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(parens, tokens));
   ClikeParser parser;
-  parser.Parse(tokens);
-}
\ No newline at end of file
+  auto ast = parser.Parse(tokens, parens.c_str());
+  REQUIRE_FALSE(parser.IsError());
+  auto assign = ast.root()->children().front();
+  REQUIRE("=" == assign->text());
+  REQUIRE("b" == assign->children().back()->text());
+
+  string blocks = string(kDepth, '{') + "a;" + string(kDepth, '}');
+  tokens.clear();
+  REQUIRE(tokenizer.LexicalAnalyze(blocks, tokens));
+  ast = parser.Parse(tokens, blocks.c_str());
+  REQUIRE_FALSE(parser.IsError());
+  size_t depth = 0;
+  auto node = ast.root();
+  while (clike_grammar::kBlock == node->symbol()) {
+    REQUIRE(1 == node->children().size());
+    node = node->children().front();
+    depth += 1;
+  }
+  REQUIRE(kDepth + 1 == depth);
+  REQUIRE("a" == node->text());
+
+  // the depth is limited
+  REQUIRE(ClikeParser::kDefaultMaxDepth == parser.max_depth());
+  parser.set_max_depth(1000);
+  ast = parser.Parse(tokens, blocks.c_str());
+  REQUIRE(parser.IsError());
+  ast = parser.Parse(tokens, parens.c_str());
+  REQUIRE(parser.IsError());
+
+  string shallow = "{{{ a = (((b))); }}}";
+  tokens.clear();
+  REQUIRE(tokenizer.LexicalAnalyze(shallow, tokens));
+  ast = parser.Parse(tokens, shallow.c_str());
+  REQUIRE_FALSE(parser.IsError());
+}
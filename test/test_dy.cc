@@ -19,21 +19,22 @@ BaseLogger logger;
 int main() {
   logger.set_log_level(kDebug);
   GET_FILE_DATA_SAFELY(data, size, "test/systest_in/loop_5.c");
-  logger.debug("\n{}", data);
+  logger.debug("\n{}", string(data, size));
 
   auto tokenizer = clike_grammar::BuilderClikeTokenizer();
   vector<Token> tokens;
-  auto result = tokenizer.LexicalAnalyze(data, data+size, tokens);
+  StringInterner interner;
+  auto result = tokenizer.LexicalAnalyze(data, data+size, tokens, &interner);
   if (!result) {
     return -1;
   }
 
   for (auto &t : tokens) {
-    logger.debug("{}", to_string(t));
+    logger.debug("{}", to_string(t, data));
   }
 
   ClikeParser parser;
-  ClikeInterpreter interpreter(parser.Parse(tokens));
+  ClikeInterpreter interpreter(parser.Parse(tokens, data));
   interpreter.Exec();
 
   interpreter.OutputLines("output.txt");
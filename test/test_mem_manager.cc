@@ -61,3 +61,54 @@ TEST_CASE("test multi times", "[multi Pool]") {
     }
   }
 }
+
+TEST_CASE("test monotonic arena", "[Monotonic Arena]") {
+  constexpr int kMaxIter = 1000;
+
+  MonotonicArena arena(256);
+  vector<Point *> points;
+
+  for (int i = 0; i < kMaxIter; ++i) {
+    auto c = static_cast<char *>(arena.Allocate(1, 1));
+    *c = 'x';
+    auto p = arena.Create<Point>(i, i + 1);
+    REQUIRE(p);
+    REQUIRE(0 == reinterpret_cast<uintptr_t>(p) % alignof(Point));
+    points.push_back(p);
+  }
+  REQUIRE(arena.slab_num() > 1);
+
+  SECTION("large allocation") {
+    auto large = arena.AllocateArray<int>(1000);
+    for (int i = 0; i < 1000; ++i) {
+      large[i] = i;
+    }
+    REQUIRE(999 == large[999]);
+  }
+
+  SECTION("move and release") {
+    MonotonicArena other(std::move(arena));
+    REQUIRE(0 == arena.slab_num());
+    other.Release();
+    REQUIRE(0 == other.slab_num());
+    REQUIRE(arena.Create<Point>(1, 2)->y == 2);
+    points.clear();
+  }
+
+  SECTION("adopt another arena") {
+    MonotonicArena owner(256);
+    auto p = owner.Create<Point>(-1, -2);
+    size_t slab_num = arena.slab_num();
+    owner.Adopt(std::move(arena));
+    REQUIRE(0 == arena.slab_num());
+    REQUIRE(slab_num + 1 == owner.slab_num());
+    REQUIRE(owner.Create<Point>(1, 2)->y == 2);
+    REQUIRE(p->y == -2);
+    points.clear();
+  }
+
+  for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+    REQUIRE(points[i]->x == i);
+    REQUIRE(points[i]->y == i + 1);
+  }
+}
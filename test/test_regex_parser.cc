@@ -142,3 +142,25 @@ TEST_CASE("meta char", "[MetaChar]") {
     REQUIRE_FALSE(dfa->Match("00__\\"));
   }
 }
+
+TEST_CASE("union DFA", "[Union]") {
+  RegexParser re_parser;
+  shared_ptr<DFA> lhs{re_parser.ParseToDFA("ab*c|x")};
+  shared_ptr<DFA> rhs{re_parser.ParseToDFA("abbd|[0-9]+")};
+  shared_ptr<DFA> dfa = UnionDFA(*lhs, *rhs);
+
+  SECTION("matched") {
+    REQUIRE(dfa->Match("ac"));
+    REQUIRE(dfa->Match("abbbc"));
+    REQUIRE(dfa->Match("x"));
+    REQUIRE(dfa->Match("abbd"));
+    REQUIRE(dfa->Match("2016"));
+  }
+
+  SECTION("unmatched") {
+    REQUIRE_FALSE(dfa->Match("ab"));
+    REQUIRE_FALSE(dfa->Match("abbbd"));
+    REQUIRE_FALSE(dfa->Match("x1"));
+    REQUIRE_FALSE(dfa->Match(""));
+  }
+}
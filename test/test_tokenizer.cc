@@ -7,7 +7,11 @@
 
 #include "catch.hpp"
 
+#include <cstdio>
+#include <sstream>
+#include <thread>
 #include "tokenizer.h"
+#include "token_stream.h"
 #include "simplelogger.h"
 
 using namespace simple_logger;
@@ -27,6 +31,8 @@ DEF_TEST_TERMINAL(k110, 1);
 DEF_TEST_TERMINAL(kNumber, 2);
 DEF_TEST_TERMINAL(kIf, 3);
 DEF_TEST_TERMINAL(kWord, 4);
+DEF_TEST_TERMINAL(kString, 5);
+DEF_TEST_TERMINAL(kWhile, 6);
 
 TEST_CASE("Build DFA") {
   TokenizerBuilder tokenizer_builder;
@@ -59,12 +65,12 @@ TEST_CASE("Lexical analyse") {
 
   REQUIRE(6 == tokens.size());
 
-  REQUIRE(tokens[0].text == "if");
-  REQUIRE(tokens[1].text == "there");
-  REQUIRE(tokens[2].text == "are");
-  REQUIRE(tokens[3].text == "\\n");
-  REQUIRE(tokens[4].text == "1000");
-  REQUIRE(tokens[5].text == "dogs");
+  REQUIRE(tokens[0].text(s.c_str()) == "if");
+  REQUIRE(tokens[1].text(s.c_str()) == "there");
+  REQUIRE(tokens[2].text(s.c_str()) == "are");
+  REQUIRE(tokens[3].text(s.c_str()) == "\n");
+  REQUIRE(tokens[4].text(s.c_str()) == "1000");
+  REQUIRE(tokens[5].text(s.c_str()) == "dogs");
 
   REQUIRE(tokens[0].symbol == kIf);
   REQUIRE(tokens[1].symbol == kWord);
@@ -72,20 +78,27 @@ TEST_CASE("Lexical analyse") {
   REQUIRE(tokens[3].symbol == kLFSymbol);
   REQUIRE(tokens[4].symbol == kNumber);
   REQUIRE(tokens[5].symbol == kWord);
+  REQUIRE(string("Word") == tokens[5].symbol.str());
+  REQUIRE(string("LF") == tokens[3].symbol.str());
 
-  REQUIRE(tokens[0].row == 1);
-  REQUIRE(tokens[1].row == 1);
-  REQUIRE(tokens[2].row == 1);
-  REQUIRE(tokens[3].row == 1);
-  REQUIRE(tokens[4].row == 3);
-  REQUIRE(tokens[5].row == 3);
-
-  REQUIRE(tokens[0].column == 0);
-  REQUIRE(tokens[1].column == 3);
-  REQUIRE(tokens[2].column == 9);
-  REQUIRE(tokens[3].column == 12);
-  REQUIRE(tokens[4].column == 0);
-  REQUIRE(tokens[5].column == 5);
+  LineIndex lines(s.c_str(), s.c_str() + s.size());
+  REQUIRE(3 == lines.size());
+  REQUIRE(lines.Row(tokens[0].offset) == 1);
+  REQUIRE(lines.Row(tokens[1].offset) == 1);
+  REQUIRE(lines.Row(tokens[2].offset) == 1);
+  REQUIRE(lines.Row(tokens[3].offset) == 1);
+  REQUIRE(lines.Row(tokens[4].offset) == 3);
+  REQUIRE(lines.Row(tokens[5].offset) == 3);
+
+  REQUIRE(lines.Column(tokens[0].offset) == 0);
+  REQUIRE(lines.Column(tokens[1].offset) == 3);
+  REQUIRE(lines.Column(tokens[2].offset) == 9);
+  REQUIRE(lines.Column(tokens[3].offset) == 12);
+  REQUIRE(lines.Column(tokens[4].offset) == 0);
+  REQUIRE(lines.Column(tokens[5].offset) == 5);
+  REQUIRE(lines.LineStart(3) == 14);
+  REQUIRE(lines.LineEnd(2) == 14);
+  REQUIRE(lines.LineEnd(3) == UINT32_MAX);
 }
 
 TEST_CASE("Skip comments") {
@@ -103,13 +116,548 @@ TEST_CASE("Skip comments") {
       "hello // world\n"
           "/* test block 1 \n"
           " test block 2 */\n"
-          "computer world"
+          "computer world /* **/ /*/ end */\n"
+          "/**///x"
   );
 
   auto tokenizer = tokenizer_builder.Build();
   vector<Token> tokens;
-  bool result = tokenizer.LexicalAnalyze(s, tokens);
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens));
   for (auto &token : tokens) {
-    logger.debug("{}", to_string(token));
+    logger.debug("{}", to_string(token, s.c_str()));
+  }
+
+  LineIndex lines(s.c_str(), s.c_str() + s.size());
+  REQUIRE(5 == tokens.size());
+  REQUIRE("hello" == tokens[0].text(s.c_str()));
+  REQUIRE(kLFSymbol == tokens[1].symbol);
+  REQUIRE(3 == lines.Row(tokens[1].offset));
+  REQUIRE("computer" == tokens[2].text(s.c_str()));
+  REQUIRE(4 == lines.Row(tokens[2].offset));
+  REQUIRE("world" == tokens[3].text(s.c_str()));
+  REQUIRE(kLFSymbol == tokens[4].symbol);
+  REQUIRE(4 == lines.Row(tokens[4].offset));
+}
+
+TEST_CASE("Skip ignored bytes in a batch") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{R"(\w+)", kWord},
+                                 {"[ \t]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetBlockComment("/*", "*/");
+  tokenizer_builder.SetIgnoreSet({kSpaceSymbol, kLFSymbol});
+  auto tokenizer = tokenizer_builder.Build();
+
+  string s{"a" + string(40, ' ') + "\n\t\n  b /*" + string(40, '*') +
+      "\n\n" + string(40, 'x') + "**/ c"};
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens));
+  LineIndex lines(s.c_str(), s.c_str() + s.size());
+  REQUIRE(3 == tokens.size());
+  REQUIRE("b" == tokens[1].text(s.c_str()));
+  REQUIRE(3 == lines.Row(tokens[1].offset));
+  REQUIRE(2 == lines.Column(tokens[1].offset));
+  REQUIRE("c" == tokens[2].text(s.c_str()));
+  REQUIRE(5 == lines.Row(tokens[2].offset));
+  REQUIRE(44 == lines.Column(tokens[2].offset));
+}
+
+TEST_CASE("Intern identifiers") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\w+)", kWord},
+                                 {"[ \t\n]", kSpaceSymbol},
+                                });
+  tokenizer_builder.SetInternSet({kWord});
+  auto tokenizer = tokenizer_builder.Build();
+
+  string s{"dog if cat\ndog cat if bird"};
+  StringInterner interner;
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens, &interner));
+  REQUIRE(7 == tokens.size());
+  REQUIRE(3 == interner.size());
+
+  REQUIRE(0 == tokens[0].value);
+  REQUIRE(1 == tokens[2].value);
+  REQUIRE(0 == tokens[3].value);
+  REQUIRE(1 == tokens[4].value);
+  REQUIRE(2 == tokens[6].value);
+  REQUIRE("bird" == interner.str(2));
+  REQUIRE(2 == interner.Intern("bird"));
+
+  // the IDs are the same when lexing in parallel
+  StringInterner parallel_interner;
+  vector<Token> parallel_tokens;
+  REQUIRE(tokenizer.LexicalAnalyzeParallel(s.c_str(), s.c_str() + s.size(),
+                                           parallel_tokens, 4, 1,
+                                           &parallel_interner));
+  REQUIRE(tokens.size() == parallel_tokens.size());
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    REQUIRE(tokens[i].value == parallel_tokens[i].value);
+  }
+
+  // the identifiers lexed without interner could not be used as IDs
+  vector<Token> uninterned;
+  REQUIRE(tokenizer.LexicalAnalyze(s, uninterned));
+  REQUIRE(kNotInterned == uninterned[0].value);
+  REQUIRE(kNotInterned == uninterned[6].value);
+  REQUIRE(0 == uninterned[1].value);
+
+  // grow the hash table
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(3 + i == interner.Intern("var" + std::to_string(i)));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    REQUIRE(3 + i == interner.Intern("var" + std::to_string(i)));
+  }
+  REQUIRE("var999" == interner.str(1002));
+}
+
+TEST_CASE("Decode integer literals") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{R"((\d+)|(0(x|X)[0-9a-fA-F]+))", kNumber},
+                                 {"[ \t\n]", kSpaceSymbol},
+                                });
+  tokenizer_builder.SetIntegerSet({kNumber});
+  auto tokenizer = tokenizer_builder.Build();
+
+  string s{"0 1024 0x1f 0XfF 017 2147483647"};
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens));
+  REQUIRE(6 == tokens.size());
+  REQUIRE(0 == tokens[0].value);
+  REQUIRE(1024 == tokens[1].value);
+  REQUIRE(31 == tokens[2].value);
+  REQUIRE(255 == tokens[3].value);
+  REQUIRE(15 == tokens[4].value);
+  REQUIRE(INT32_MAX == tokens[5].value);
+
+  tokens.clear();
+  REQUIRE_FALSE(tokenizer.LexicalAnalyze("1 2147483648", tokens));
+  tokens.clear();
+  REQUIRE_FALSE(tokenizer.LexicalAnalyze("0x80000000", tokens));
+}
+
+TEST_CASE("Token stream") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {"[ \t\v\f\r\n]", kSpaceSymbol},
+                                });
+  auto tokenizer = tokenizer_builder.Build();
+
+  string s{"if there\tare\n\n1000 dogs"};
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens));
+  REQUIRE(5 == tokens.size());
+
+  SECTION("pull lazily from tokenizer") {
+    TokenStream stream(tokenizer, s.c_str(), s.c_str() + s.size());
+    REQUIRE(stream.source() == s.c_str());
+
+    REQUIRE(tokens[1] == stream.Peek(1));
+    REQUIRE(tokens[2] == stream.Peek(2));
+    for (auto &token : tokens) {
+      REQUIRE(token == *stream);
+      REQUIRE(token == stream.Next());
+    }
+    REQUIRE(kEofSymbol == stream->symbol);
+    REQUIRE(kEofSymbol == stream.Next().symbol);
+    REQUIRE(kEofSymbol == stream.Peek(3).symbol);
+    REQUIRE_FALSE(stream.IsError());
+  }
+
+  SECTION("read from extracted tokens") {
+    TokenStream stream(tokens, s.c_str());
+    for (auto &token : tokens) {
+      REQUIRE(token == stream.Next());
+    }
+    REQUIRE(kEofSymbol == stream.Next().symbol);
+    REQUIRE_FALSE(stream.IsError());
+  }
+
+  SECTION("read from token buffer") {
+    TokenBuffer buffer;
+    REQUIRE(tokenizer.LexicalAnalyze(s.c_str(), s.c_str() + s.size(), buffer));
+    REQUIRE(tokens.size() == buffer.size());
+    REQUIRE(buffer.code(1) == buffer.code(2));
+    REQUIRE(buffer.code(0) != buffer.code(1));
+    REQUIRE(kNumber == buffer.symbol_of(buffer.code(3)));
+
+    TokenStream stream(buffer, s.c_str());
+    REQUIRE(stream.source_end() == s.c_str() + s.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      REQUIRE(tokens[i] == buffer[i]);
+      REQUIRE(tokens[i] == stream.Next());
+    }
+    REQUIRE(kEofSymbol == stream.Next().symbol);
+    REQUIRE_FALSE(stream.IsError());
+  }
+
+  SECTION("lexical error") {
+    string error_s{"if $ dogs"};
+    TokenStream stream(tokenizer, error_s.c_str(),
+                       error_s.c_str() + error_s.size());
+    REQUIRE(kIf == stream.Next().symbol);
+    REQUIRE(kEofSymbol == stream.Next().symbol);
+    REQUIRE(stream.IsError());
+  }
+}
+
+TEST_CASE("Lex concurrently with one tokenizer") {
+  constexpr int kThreadNum = 8;
+  constexpr int kInputNum = 64;
+
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {"[ \t\v\f\r]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetLineComment("//");
+  tokenizer_builder.SetBlockComment("/*", "*/");
+  const auto tokenizer = tokenizer_builder.Build();
+
+  vector<string> inputs;
+  vector<vector<Token>> expects(kInputNum);
+  for (int i = 0; i < kInputNum; ++i) {
+    string s;
+    for (int j = 0; j <= i; ++j) {
+      s += "if dog" + std::to_string(j) + " /* block\n */ " +
+          std::to_string(i * j) + " // line\n";
+    }
+    inputs.push_back(s);
+    REQUIRE(tokenizer.LexicalAnalyze(inputs.back(), expects[i]));
+  }
+
+  vector<vector<Token>> results(kInputNum);
+  vector<int> succeeds(kInputNum, 0);
+  vector<std::thread> threads;
+  for (int t = 0; t < kThreadNum; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < kInputNum; i += kThreadNum) {
+        succeeds[i] = tokenizer.LexicalAnalyze(inputs[i], results[i]);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < kInputNum; ++i) {
+    REQUIRE(succeeds[i]);
+    REQUIRE(expects[i].size() == results[i].size());
+    for (size_t k = 0; k < expects[i].size(); ++k) {
+      REQUIRE(expects[i][k] == results[i][k]);
+    }
+  }
+}
+
+TEST_CASE("Lex a source text in parallel chunks") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {R"("[^"]*")", kString},
+                                 {"[ \t\v\f\r]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetLineComment("//");
+  tokenizer_builder.SetBlockComment("/*", "*/");
+  const auto tokenizer = tokenizer_builder.Build();
+
+  // comments and strings crossing lines make the speculation wrong
+  string s;
+  for (int i = 0; i < 50; ++i) {
+    s += "if dog" + std::to_string(i) + " /* block\n\n" +
+        "if 12 */ " + std::to_string(i) + " // line\n\n" +
+        "\"string\n" + std::to_string(i) + "\n\" cat\n";
+  }
+
+  vector<Token> expects;
+  REQUIRE(tokenizer.LexicalAnalyze(s, expects));
+
+  for (size_t thread_num : {2, 3, 7, 16}) {
+    for (size_t chunk_size : {1, 7, 64}) {
+      vector<Token> results;
+      REQUIRE(tokenizer.LexicalAnalyzeParallel(s.c_str(), s.c_str() + s.size(),
+                                               results, thread_num,
+                                               chunk_size));
+      REQUIRE(expects.size() == results.size());
+      for (size_t k = 0; k < expects.size(); ++k) {
+        REQUIRE(expects[k] == results[k]);
+      }
+    }
+  }
+
+  vector<Token> results;
+  s += "\n$ dog";
+  REQUIRE_FALSE(tokenizer.LexicalAnalyzeParallel(s.c_str(),
+                                                 s.c_str() + s.size(),
+                                                 results, 4, 1));
+}
+
+TEST_CASE("Report an error found in a parallel chunk") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {"[ \t\v\f\r]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetIntegerSet({kNumber});
+  const auto tokenizer = tokenizer_builder.Build();
+
+  // the errors are far past the first chunk boundary
+  string s;
+  for (int i = 0; i < 20; ++i) {
+    s += "dog " + std::to_string(i) + "\n";
+  }
+
+  // lex serially and in parallel, and capture the messages reported
+  auto capture = [&tokenizer](const string &s, bool is_parallel) {
+    FILE *file = tmpfile();
+    REQUIRE(file);
+    logger.set_level_file(kError, file);
+    vector<Token> tokens;
+    const bool is_ok = is_parallel
+        ? tokenizer.LexicalAnalyzeParallel(s.c_str(), s.c_str() + s.size(),
+                                           tokens, 4, 1)
+        : tokenizer.LexicalAnalyze(s, tokens);
+    logger.set_level_file(kError, stdout);
+    REQUIRE_FALSE(is_ok);
+    string message(256, '\0');
+    rewind(file);
+    message.resize(fread(&message[0], 1, message.size(), file));
+    fclose(file);
+    return message;
+  };
+
+  SECTION("out-of-range integer literal") {
+    s += "cat 99999999999 dog\n";
+    const string message = capture(s, true);
+    REQUIRE(string::npos != message.find("99999999999 is out of range"));
+    REQUIRE(string::npos != message.find("(21, 4)"));
+    REQUIRE(capture(s, false) == message);
+  }
+
+  SECTION("unknown character") {
+    s += "cat $ dog\n";
+    const string message = capture(s, true);
+    REQUIRE(string::npos == message.find("out of range"));
+    REQUIRE(capture(s, false) == message);
+  }
+}
+
+TEST_CASE("Relex after editing") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {R"("[^"]*")", kString},
+                                 {"[ \t\v\f\r]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetLineComment("//");
+  tokenizer_builder.SetBlockComment("/*", "*/");
+  tokenizer_builder.SetInternSet({kWord});
+  const auto tokenizer = tokenizer_builder.Build();
+
+  string s;
+  for (int i = 0; i < 20; ++i) {
+    s += "if dog" + std::to_string(i) + " /* block */ " + std::to_string(i) +
+        " // line\n\n\"string\" cat\n";
+  }
+  StringInterner interner;
+  vector<Token> tokens;
+  REQUIRE(tokenizer.LexicalAnalyze(s, tokens, &interner));
+
+  const vector<string> snippets{"", "x", " ", "\n", "/*", "*/", "//", "\"",
+                                "12", "if", "\n\n"};
+  uint32_t seed = 12345;
+  auto random = [&seed](uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+  };
+
+  for (int i = 0; i < 500; ++i) {
+    uint32_t offset = random(static_cast<uint32_t>(s.size()) + 1);
+    uint32_t removed = std::min<uint32_t>(random(4),
+                                          static_cast<uint32_t>(s.size())
+                                              - offset);
+    string inserted = snippets[random(snippets.size())];
+
+    string edited = s;
+    vector<Token> relexed = tokens;
+    bool is_ok = tokenizer.Relex(edited, relexed, offset, removed, inserted,
+                                 &interner);
+
+    vector<Token> expects;
+    REQUIRE(is_ok == tokenizer.LexicalAnalyze(edited, expects, &interner));
+    if (!is_ok) {
+      REQUIRE(relexed.size() == tokens.size());
+      continue;
+    }
+
+    REQUIRE(expects.size() == relexed.size());
+    for (size_t k = 0; k < expects.size(); ++k) {
+      REQUIRE(expects[k] == relexed[k]);
+      REQUIRE(expects[k].value == relexed[k].value);
+    }
+    s = edited;
+    tokens = relexed;
+  }
+}
+
+TEST_CASE("Lex a stream through a small buffer") {
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns({{"if", kIf},
+                                 {R"(\d+)", kNumber},
+                                 {R"(\w+)", kWord},
+                                 {R"("[^"]*")", kString},
+                                 {"[ \t\v\f\r]", kSpaceSymbol},
+                                 {"\n", kLFSymbol},
+                                });
+  tokenizer_builder.SetLineComment("//");
+  tokenizer_builder.SetBlockComment("/*", "*/");
+  tokenizer_builder.SetInternSet({kWord});
+  tokenizer_builder.SetIntegerSet({kNumber});
+  const auto tokenizer = tokenizer_builder.Build();
+
+  string s;
+  for (int i = 0; i < 20; ++i) {
+    s += "if dog" + std::to_string(i) + " /* a block comment longer than "
+        "the buffer */ " + std::to_string(i * 1234) +
+        " // line\n\n\n\"a string\" cat\n";
+  }
+  StringInterner expect_interner;
+  vector<Token> expects;
+  REQUIRE(tokenizer.LexicalAnalyze(s, expects, &expect_interner));
+
+  struct StreamToken {
+    Symbol symbol;
+    string text;
+    uint32_t value;
+  };
+  vector<StreamToken> results;
+  auto sink = [&results](const Token &token, const char *source) {
+    results.push_back({token.symbol, token.text(source), token.value});
+    return true;
+  };
+
+  SECTION("read from std::istream") {
+    for (size_t buffer_size = 12; buffer_size <= 64; buffer_size += 7) {
+      std::istringstream in(s);
+      StringInterner interner;
+      results.clear();
+      REQUIRE(tokenizer.LexicalAnalyze(in, sink, buffer_size, &interner));
+
+      REQUIRE(expects.size() == results.size());
+      for (size_t i = 0; i < expects.size(); ++i) {
+        REQUIRE(expects[i].symbol == results[i].symbol);
+        REQUIRE(expects[i].text(s.c_str()) == results[i].text);
+        REQUIRE(expects[i].value == results[i].value);
+      }
+    }
+  }
+
+  SECTION("read from file descriptor") {
+    FILE *file = tmpfile();
+    REQUIRE(file);
+    REQUIRE(s.size() == fwrite(s.data(), 1, s.size(), file));
+    fflush(file);
+    rewind(file);
+    REQUIRE(tokenizer.LexicalAnalyze(fileno(file), sink, 16));
+    fclose(file);
+    REQUIRE(expects.size() == results.size());
+  }
+
+  SECTION("stop by the sink") {
+    std::istringstream in(s);
+    size_t count = 0;
+    REQUIRE(tokenizer.LexicalAnalyze(
+        in, [&count](const Token &, const char *) { return ++count < 5; }, 16));
+    REQUIRE(5 == count);
+  }
+
+  SECTION("lexeme longer than the buffer") {
+    std::istringstream in("if \"a string longer than the buffer\" cat");
+    REQUIRE_FALSE(tokenizer.LexicalAnalyze(in, sink, 16));
+  }
+}
+
+TEST_CASE("Add and remove patterns incrementally") {
+  const vector<TokenPattern> patterns{{"if", kIf},
+                                      {R"(\d+)", kNumber},
+                                      {R"(\w+)", kWord},
+                                      {"[ \t\v\f\r\n]", kSpaceSymbol},
+                                     };
+  TokenizerBuilder tokenizer_builder;
+  tokenizer_builder.SetPatterns(patterns);
+  tokenizer_builder.SetLineComment("//");
+  const auto origin = tokenizer_builder.Build();
+
+  const string s = "if while whiles 110 // comment\n"
+      "while1 0x1 ifwhile if\n";
+  auto lex = [&s](const Tokenizer &tokenizer) {
+    vector<Token> tokens;
+    REQUIRE(tokenizer.LexicalAnalyze(s, tokens));
+    return tokens;
+  };
+  auto rebuild = [](const vector<TokenPattern> &patterns) {
+    TokenizerBuilder tokenizer_builder;
+    tokenizer_builder.SetPatterns(patterns);
+    tokenizer_builder.SetLineComment("//");
+    return tokenizer_builder.Build();
+  };
+  const auto origin_tokens = lex(origin);
+
+  // the keyword is higher than words, the number is lower than others
+  tokenizer_builder.AddPattern({"while", kWhile}, 1);
+  tokenizer_builder.AddPattern({"0x1", kNumber});
+  auto added = tokenizer_builder.Build();
+  auto added_tokens = lex(added);
+  REQUIRE(added_tokens == lex(rebuild({{"if", kIf},
+                                       {"while", kWhile},
+                                       {R"(\d+)", kNumber},
+                                       {R"(\w+)", kWord},
+                                       {"[ \t\v\f\r\n]", kSpaceSymbol},
+                                       {"0x1", kNumber},
+                                      })));
+  REQUIRE(kWhile == added_tokens[1].symbol);
+  REQUIRE(kWord == added_tokens[2].symbol);
+  REQUIRE(kWord == added_tokens[4].symbol);
+
+  // the built tokenizer is not changed
+  REQUIRE(origin_tokens == lex(origin));
+
+  SECTION("remove an added pattern") {
+    REQUIRE(tokenizer_builder.RemovePattern("while"));
+    REQUIRE_FALSE(tokenizer_builder.RemovePattern("while"));
+    REQUIRE(lex(tokenizer_builder.Build()) == lex(rebuild(
+        {{"if", kIf},
+         {R"(\d+)", kNumber},
+         {R"(\w+)", kWord},
+         {"[ \t\v\f\r\n]", kSpaceSymbol},
+         {"0x1", kNumber},
+        })));
+  }
+
+  SECTION("remove a base pattern") {
+    REQUIRE(tokenizer_builder.RemovePattern("if"));
+    const auto removed = tokenizer_builder.Build();
+    REQUIRE(lex(removed) == lex(rebuild({{"while", kWhile},
+                                         {R"(\d+)", kNumber},
+                                         {R"(\w+)", kWord},
+                                         {"[ \t\v\f\r\n]", kSpaceSymbol},
+                                         {"0x1", kNumber},
+                                        })));
+
+    // added again after the full rebuilding
+    tokenizer_builder.AddPattern({"if", kIf}, 0);
+    REQUIRE(lex(tokenizer_builder.Build()) == added_tokens);
   }
 }
@@ -4,40 +4,12 @@
 
 #pragma once
 
-#include <cstring>
-#include <fstream>
-#include <string>
-
-#include "utility.h"
-
-inline std::streampos GetFileLength(std::ifstream &fin) {
-  auto backup = fin.tellg();
-  fin.seekg(0, fin.end);
-  auto length = fin.tellg();
-  fin.seekg(backup, fin.beg);
-  return length;
-}
-
-inline char *ReadFileData(const std::string &path, size_t &size) {
-  std::ifstream fin(path);
-  if (!fin) {
-    return nullptr;
-  }
-
-  size = static_cast<size_t>(GetFileLength(fin));
-  auto data = new char[size + 1];
-  memset(data, 0, sizeof(char) * (size + 1));
-
-  if (fin.read(data, size)) {
-    return data;
-  } else {
-    delete data;
-    return nullptr;
-  }
-}
+#include "mapped_file.h"
 
+/**
+ * The data is mapped from file, and NOT terminated by '\0'
+ */
 #define GET_FILE_DATA_SAFELY(name, size, relative_path) \
-size_t size = 0; \
-const char *name = ReadFileData((relative_path), (size)); \
-ScopeGuard [&] { delete[] name; };
-
+MappedFile name##_file(relative_path); \
+size_t size = name##_file.size(); \
+const char *name = name##_file.data();